@@ -89,26 +89,12 @@ cx22702::cx22702(tuner_config &config, tuner_device &device, dvb_input_t input,
 
 int cx22702::enable_pll(void)
 {
-   uint8_t buffer[] = {0x0D, 0x00};
-   int error = m_device.transact(buffer, 1, &(buffer[1]), 1);
-   if (!error)
-   {
-      buffer[1] &= 0xFE;
-      error = m_device.write(buffer, sizeof(buffer));
-   }
-   return error;
+   return m_device.update_bits(0x0D, 0x01, 0x00);
 }
 
 int cx22702::disable_pll(void)
 {
-   uint8_t buffer[] = {0x0D, 0x00};
-   int error = m_device.transact(buffer, 1, &(buffer[1]), 1);
-   if (!error)
-   {
-      buffer[1] |= 0x01;
-      error = m_device.write(buffer, sizeof(buffer));
-   }
-   return error;  
+   return m_device.update_bits(0x0D, 0x01, 0x01);
 }
 
 int cx22702::set_channel(const dvb_channel &channel, dvb_interface &interface)
@@ -117,24 +103,18 @@ int cx22702::set_channel(const dvb_channel &channel, dvb_interface &interface)
    interface.clock = DVB_IFC_NORM_CLCK;
    interface.polarity = DVB_IFC_NEG_POL;
    interface.bit_endianness = DVB_IFC_BIT_BE;
-   uint8_t transaction[] = {0x0C, 0x00};
-   int error = m_device.transact(transaction, 1, &(transaction[1]), 1);
-   if (error)
-   {
-      return error;  
-   }
-   transaction[1] &= 0xCE;
+   uint8_t mode = 0x00;
    if (channel.inversion == DVB_INVERSION_ON)
    {
-      transaction[1] |= 0x01;
+      mode |= 0x01;
    }
    switch (channel.bandwidth_hz)
    {
       case 6000000:
-         transaction[1] |= 0x20;
+         mode |= 0x20;
          break;
       case 7000000:
-         transaction[1] |= 0x10;
+         mode |= 0x10;
          break;
       case 8000000:
          break;
@@ -142,10 +122,12 @@ int cx22702::set_channel(const dvb_channel &channel, dvb_interface &interface)
          LIBTUNERERR << "CX22702: Invalid bandwidth setting: " << channel.bandwidth_hz << endl;
          return EINVAL;
    }
-   if ((error = m_device.write(transaction, sizeof(transaction))))
+   int error = m_device.update_bits(0x0C, 0x31, mode);
+   if (error)
    {
       return error;
    }
+   uint8_t transaction[2];
    // Auto hierarchy and subcarrier modulation
    transaction[0] = 0x06;
    transaction[1] = 0x10;
@@ -29,9 +29,11 @@
 #define __CX22702_H__
 
 #include "dvb_driver.h"
+#include "tuner_gate.h"
 
 class cx22702
-   : public dvb_driver
+   : public dvb_driver,
+     public tuner_gate
 {
    public:
          
@@ -52,6 +54,16 @@ class cx22702
       int enable_pll(void);
       
       int disable_pll(void);
+
+      virtual int gate_open(void)
+      {
+         return enable_pll();
+      }
+
+      virtual int gate_close(void)
+      {
+         return disable_pll();
+      }
       
    private:
       
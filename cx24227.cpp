@@ -126,35 +126,16 @@ cx24227::cx24227(
    error = (error ? error : set_ifreq());
    if (!error)
    {
-      uint8_t gpio_config[3];
-      gpio_config[0] = 0xE3;
-      error = m_device.transact(gpio_config, 1, &(gpio_config[1]), 2);
-      if (!error)
+      if (gpio == CX24227_GPIO_ENABLE)
       {
-         if ((gpio == CX24227_GPIO_ENABLE) && ((gpio_config[1] & 0x11) != 0x11))
-         {
-            gpio_config[1] |= 0x11;
-            error = m_device.write(gpio_config, 3);
-         }
-         else if ((gpio == CX24227_GPIO_DISABLE) && (gpio_config[1] & 0x01))
-         {
-            gpio_config[1] &= 0xFE;
-            error = m_device.write(gpio_config, 3);
-         }
+         error = m_device.update_bits16(0xE3, 0x1100, 0x1100);
       }
-   }
-   if (!error)
-   {
-      uint8_t timing[3];
-      timing[0] = 0xAC;
-      error = m_device.transact(timing, 1, &(timing[1]), 2);
-      if (!error)
+      else
       {
-         timing[1] &= 0xCF;
-         timing[1] |= (clock << 4);
-         error = m_device.write(timing, 3);
+         error = m_device.update_bits16(0xE3, 0x0100, 0x0000);
       }
    }
+   error = (error ? error : m_device.update_bits16(0xAC, 0x3000, (uint16_t)clock << 12));
    error = (error ? error : soft_reset());
    error = (error ? error : i2c_gate(0x01));
 }
@@ -29,6 +29,7 @@
 #define __CX24227_H__
 
 #include "dvb_driver.h"
+#include "tuner_gate.h"
 
 enum cx24227_gpio_t
 {
@@ -51,7 +52,8 @@ enum cx24227_clock_t
 };
 
 class cx24227
-   : public dvb_driver
+   : public dvb_driver,
+     public tuner_gate
 {
    
    public:
@@ -76,6 +78,16 @@ class cx24227
       virtual void stop(void);
 
       virtual void reset(void);
+
+      virtual int gate_open(void)
+      {
+         return i2c_gate(0x01);
+      }
+
+      virtual int gate_close(void)
+      {
+         return i2c_gate(0x00);
+      }
       
    private:
    
@@ -61,6 +61,7 @@ mt2131::mt2131(tuner_config &config, tuner_device &device, int &error)
    {
       0x10, 0x7f, 0xc8, 0x0a, 0x5f, 0x00, 0x04
    };
+   tuner_device::bus_lock lock(m_device);
    if (!error)
    {
       error = m_device.write(config1, sizeof(config1));
@@ -94,6 +95,7 @@ int mt2131::set_frequency(uint32_t freq_hz)
    div_buf[4] = (div2 >> 5) & 0xFF;
    div_buf[5] = div2 & 0x1F;
    div_buf[6] = div2 / 8192;
+   tuner_device::bus_lock lock(m_device);
    int error = m_device.write(div_buf, sizeof(div_buf));
    if (error)
    {
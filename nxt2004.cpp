@@ -32,6 +32,10 @@
 
 #define CCITT_DIVISOR 0x1021
 #define NXT2004_FW_KEY "NXT2004_FW"
+#define NXT2004_FW_BUS_HZ_KEY "NXT2004_FW_BUS_HZ"
+
+static tuner_config_key nxt2004_fw_key(NXT2004_FW_KEY);
+static tuner_config_key nxt2004_fw_bus_hz_key(NXT2004_FW_BUS_HZ_KEY);
 
 using namespace std;
 
@@ -153,29 +157,33 @@ int nxt2004::write_microcontroller(uint8_t *data, size_t num_bytes)
    {
       return EINVAL;
    }
-   uint8_t buffer[2];
-   buffer[0] = 0x35;
-   buffer[1] = data[0];
-   int error = m_device.write(buffer, sizeof(buffer));
-   data[0] = 0x36;
-   error = (error ? error : m_device.write(data, num_bytes));
-   data[0] = buffer[1];
-   buffer[0] = 0x34;
-   buffer[1] = num_bytes - 1;
+   uint8_t addr[2], count[2], start[2], status = 0xFF;
+   addr[0] = 0x35;
+   addr[1] = data[0];
+   count[0] = 0x34;
+   count[1] = num_bytes - 1;
    if ((data[0] & 0x80) && (data[0] != 0x4))
    {
-      buffer[1] |= 0x50;
+      count[1] |= 0x50;
    }
    else
    {
-      buffer[1] |= 0x30;
+      count[1] |= 0x30;
    }
-   error = (error ? error : m_device.write(buffer, sizeof(buffer)));
-   buffer[0] = 0x21;
-   buffer[1] = 0x80;
-   error = (error ? error : m_device.write(buffer, sizeof(buffer)));
-   error = (error ? error : m_device.transact(buffer, 1, &(buffer[1]), 1));
-   if (buffer[1] != 0)
+   start[0] = 0x21;
+   start[1] = 0x80;
+   data[0] = 0x36;
+   const tuner_op ops[] =
+   {
+      {TUNER_OP_WRITE, addr, sizeof(addr), NULL, 0},
+      {TUNER_OP_WRITE, data, num_bytes, NULL, 0},
+      {TUNER_OP_WRITE, count, sizeof(count), NULL, 0},
+      {TUNER_OP_WRITE, start, sizeof(start), NULL, 0},
+      {TUNER_OP_TRANSACT, start, 1, &status, 1}
+   };
+   int error = m_device.submit(ops, sizeof(ops) / sizeof(ops[0]));
+   data[0] = addr[1];
+   if (status != 0)
    {
       error = (error ? error : EINVAL);
    }
@@ -188,31 +196,34 @@ int nxt2004::read_microcontroller(uint8_t *data, size_t num_bytes)
    {
       return EINVAL;
    }
-   uint8_t buffer[2];
-   buffer[0] = 0x35;
-   buffer[1] = data[0];
-   int error = m_device.write(buffer, sizeof(buffer));
-   buffer[0] = 0x34;
-   buffer[1] = num_bytes - 1;
+   uint8_t addr[2], count[2], start[2], reg = 0x36;
+   addr[0] = 0x35;
+   addr[1] = data[0];
+   count[0] = 0x34;
+   count[1] = num_bytes - 1;
    if ((data[0] & 0x80) && (data[0] != 0x4))
    {
-      buffer[1] |= 0x40;
+      count[1] |= 0x40;
    }
    else
    {
-      buffer[1] |= 0x20;
+      count[1] |= 0x20;
    }
-   error = (error ? error : m_device.write(buffer, sizeof(buffer)));
-   buffer[0] = 0x21;
-   buffer[1] = 0x80;
-   error = (error ? error : m_device.write(buffer, sizeof(buffer)));
-   buffer[0] = 0x36;
-   error = (error ? error : m_device.transact(buffer, 1, &(data[1]), num_bytes - 1));
-   return error;
+   start[0] = 0x21;
+   start[1] = 0x80;
+   const tuner_op ops[] =
+   {
+      {TUNER_OP_WRITE, addr, sizeof(addr), NULL, 0},
+      {TUNER_OP_WRITE, count, sizeof(count), NULL, 0},
+      {TUNER_OP_WRITE, start, sizeof(start), NULL, 0},
+      {TUNER_OP_TRANSACT, &reg, 1, &(data[1]), num_bytes - 1}
+   };
+   return m_device.submit(ops, sizeof(ops) / sizeof(ops[0]));
 }
 
 int nxt2004::soft_reset(void)
 {
+   tuner_device::bus_lock lock(m_device);
    uint8_t buffer[2];
    buffer[0] = 0x8;
    int error = read_microcontroller(buffer, 2);
@@ -224,48 +235,51 @@ int nxt2004::soft_reset(void)
    return error;
 }
 
-int nxt2004::init(void)
+int nxt2004::load_firmware(tuner_firmware &fw)
 {
-   uint8_t buffer[256];
+   uint8_t buffer[4];
    buffer[0] = 0x1E;
    buffer[1] = 0x0;
    int error = m_device.write(buffer, 2);
-   if (error)
+   buffer[0] = 0x19;
+   error = (error ? error : m_device.transact(buffer, 1, &buffer[1], 1));
+   if (error || ((buffer[1] == 0x1) && fw.up_to_date()))
    {
       return error;
    }
-   
-   const char *fwfile = m_config.get_string(NXT2004_FW_KEY);
-   if (fwfile == NULL)
+   buffer[0] = 0x2B;
+   buffer[1] = 0x80;
+   error = m_device.write(buffer, 2);
+   if (error)
    {
-      LIBTUNERERR << "nxt2004: Firmware file not configured" << endl;
-      return ENOENT;
+      LIBTUNERERR << "nxt2004: Unable to create firmware image: " << strerror(errno) << endl;
+      return error;
    }
-   buffer[0] = 0x19;
-   error = (error ? error : m_device.transact(buffer, 1, &buffer[1], 1));
-   tuner_firmware fw(m_config, fwfile, error);
-   if (!error && ((buffer[1] != 0x1) || !fw.up_to_date()))
+   uint8_t *fwdata = reinterpret_cast<uint8_t*>(fw.buffer());
+   buffer[0] = 0x29;
+   buffer[1] = 0x10;
+   buffer[2] = 0x00;
+   buffer[3] = 0x81;
+   error = (error ? error : m_device.write(buffer, 4));
+   
+   LIBTUNERLOG << "nxt2004: Loading firmware..." << endl;
+   tuner_device::bus_speed speed(m_device, m_config.get_number<uint32_t>(nxt2004_fw_bus_hz_key, 0));
+   buffer[0] = 0x2C;
+   size_t max_transfer = m_device.max_transfer_size();
+   max_transfer = ((max_transfer > 1) ? (max_transfer - 1) : 255);
+   uint16_t crc = 0;
+   struct iovec iov[2];
+   iov[0].iov_base = buffer;
+   iov[0].iov_len = 1;
+   for (size_t offset = 0; !error && (offset < fw.length()); offset += iov[1].iov_len)
    {
-      buffer[0] = 0x2B;
-      buffer[1] = 0x80;
-      error = m_device.write(buffer, 2);
-      if (error)
+      iov[1].iov_base = fwdata + offset;
+      iov[1].iov_len = fw.length() - offset;
+      if (iov[1].iov_len > max_transfer)
       {
-         LIBTUNERERR << "nxt2004: Unable to create firmware image: " << strerror(errno) << endl;
-         return error;
+         iov[1].iov_len = max_transfer;
       }
-      uint8_t *fwdata = reinterpret_cast<uint8_t*>(fw.buffer());
-      buffer[0] = 0x29;
-      buffer[1] = 0x10;
-      buffer[2] = 0x00;
-      buffer[3] = 0x81;
-      error = (error ? error : m_device.write(buffer, 4));
-      
-      LIBTUNERLOG << "nxt2004: Loading firmware..." << endl;
-      buffer[0] = 0x2C;
-      uint16_t crc = 0;
-      size_t offset = 0;
-      for (size_t i = 0; i < fw.length(); ++i)
+      for (size_t i = offset; i < (offset + iov[1].iov_len); ++i)
       {
          uint16_t comparand = (uint16_t)(fwdata[i]) << 8;
          for (uint8_t shift = 0; shift < 8; ++shift)
@@ -277,34 +291,39 @@ int nxt2004::init(void)
             }
             comparand <<= 1;
          }
-         size_t bufindex = i - offset + 1;
-         buffer[bufindex] = fwdata[i];
-         if ((bufindex == 255) || (i == (fw.length() - 1)))
-         {
-            error = m_device.write(buffer, bufindex + 1);
-            if (error)
-            {
-               break;
-            }
-            offset = i + 1;
-         }
-      }
-      buffer[1] = crc >> 8;
-      buffer[2] = crc & 0xFF;
-      error = (error ? error : m_device.write(buffer, 3));
-      LIBTUNERLOG << "nxt2004: Finished" << endl;
-
-      error = (error ? error : m_device.transact(buffer, 1, &(buffer[1]), 1));
-      buffer[0] = 0x2B;
-      buffer[1] = 0x80;
-      error = (error ? error : m_device.write(buffer, 2));
-      buffer[0] = 0x19;
-      buffer[1] = 0x1;
-      error = (error ? error : m_device.write(buffer, 2));
-      if (!error)
-      {
-         fw.update();
       }
+      error = m_device.write(iov, 2);
+   }
+   buffer[1] = crc >> 8;
+   buffer[2] = crc & 0xFF;
+   error = (error ? error : m_device.write(buffer, 3));
+   LIBTUNERLOG << "nxt2004: Finished" << endl;
+
+   error = (error ? error : m_device.transact(buffer, 1, &(buffer[1]), 1));
+   buffer[0] = 0x2B;
+   buffer[1] = 0x80;
+   error = (error ? error : m_device.write(buffer, 2));
+   buffer[0] = 0x19;
+   buffer[1] = 0x1;
+   error = (error ? error : m_device.write(buffer, 2));
+   return error;
+}
+
+int nxt2004::init(void)
+{
+   uint8_t buffer[256];
+   const char *fwfile = m_config.get_string(nxt2004_fw_key);
+   if (fwfile == NULL)
+   {
+      LIBTUNERERR << "nxt2004: Firmware file not configured" << endl;
+      return ENOENT;
+   }
+   int error = 0;
+   tuner_firmware fw(m_config, fwfile, error);
+   error = (error ? error : load_firmware(fw));
+   if (!error)
+   {
+      fw.update();
    }
 
    // ???
@@ -319,22 +338,23 @@ int nxt2004::init(void)
    error = (error ? error : write_microcontroller(buffer, 2));
    buffer[1] = 0x0;
    error = (error ? error : write_microcontroller(buffer, 2));
-   buffer[0] = 0x57;
-   buffer[1] = 0xD7;
-   error = (error ? error : m_device.write(buffer, 2));
-   buffer[0] = 0x35;
-   buffer[1] = 0x7;
-   buffer[2] = 0xFE;
-   error = (error ? error : m_device.write(buffer, 3));
-   buffer[0] = 0x34;
-   buffer[1] = 0x12;
-   error = (error ? error : m_device.write(buffer, 2));
-   buffer[0] = 0x21;
-   buffer[1] = 0x80;
-   error = (error ? error : m_device.write(buffer, 2));
-   buffer[0] = 0xA;
-   buffer[1] = 0x21;
-   error = (error ? error : m_device.write(buffer, 2));
+   static const uint8_t mc_config[] =
+   {
+      0x57, 0xD7,
+      0x35, 0x07, 0xFE,
+      0x34, 0x12,
+      0x21, 0x80,
+      0x0A, 0x21
+   };
+   static const tuner_op mc_config_ops[] =
+   {
+      {TUNER_OP_WRITE, mc_config, 2, NULL, 0},
+      {TUNER_OP_WRITE, mc_config + 2, 3, NULL, 0},
+      {TUNER_OP_WRITE, mc_config + 5, 2, NULL, 0},
+      {TUNER_OP_WRITE, mc_config + 7, 2, NULL, 0},
+      {TUNER_OP_WRITE, mc_config + 9, 2, NULL, 0}
+   };
+   error = (error ? error : m_device.submit(mc_config_ops, sizeof(mc_config_ops) / sizeof(mc_config_ops[0])));
 
    buffer[0] = 0x80;
    buffer[1] = 0x1;
@@ -462,64 +482,50 @@ int nxt2004::start(uint32_t timeout_ms)
    error = (error ? error : write_microcontroller(buffer, 2));
    buffer[1] = 0x0;
    error = (error ? error : write_microcontroller(buffer, 2));
-   buffer[0] = 0x42;
+   uint8_t demod_config[] =
+   {
+      0x42, 0x00,
+      0x57, 0x07,
+      0x58, 0x10, 0x00,
+      0x5C, 0x64, 0x00,
+      0x43, 0x05,
+      0x46, 0x00, 0x00,
+      0x4B, 0x80, 0x00,
+      0x4D, 0x00,
+      0x55, 0x44,
+      0x41, 0x04
+   };
    switch (m_modulation)
    {
       case DVB_MOD_VSB_8:
-         buffer[1] = 0x70;
+         demod_config[1] = 0x70;
+         demod_config[8] = 0x60;
          break;
       case DVB_MOD_QAM_64:
+         demod_config[1] = 0x74;
+         demod_config[8] = 0x68;
+         break;
       case DVB_MOD_QAM_256:
       case DVB_MOD_QAM_AUTO:
-         buffer[1] = 0x74;
+         demod_config[1] = 0x74;
          break;
       default:
          error = (error ? error : EINVAL);
    }
-   error = (error ? error : m_device.write(buffer, 2));
-   buffer[0] = 0x57;
-   buffer[1] = 0x7;
-   error = (error ? error : m_device.write(buffer, 2));
-   buffer[0] = 0x58;
-   buffer[1] = 0x10;
-   buffer[2] = 0x0;
-   error = (error ? error : m_device.write(buffer, 3));
-   buffer[0] = 0x5C;
-   switch (m_modulation)
+   const tuner_op demod_config_ops[] =
    {
-      case DVB_MOD_VSB_8:
-         buffer[1] = 0x60;
-         break;
-      case DVB_MOD_QAM_64:
-         buffer[1] = 0x68;
-         break;
-      case DVB_MOD_QAM_256:
-      default:
-         buffer[1] = 0x64;
-         break;
-   }
-   buffer[2] = 0x0;
-   error = (error ? error : m_device.write(buffer, 3));
-   buffer[0] = 0x43;
-   buffer[1] = 0x5;
-   error = (error ? error : m_device.write(buffer, 2));
-   buffer[0] = 0x46;
-   buffer[1] = 0x0;
-   buffer[2] = 0x0;
-   error = (error ? error : m_device.write(buffer, 3));
-   buffer[0] = 0x4B;
-   buffer[1] = 0x80;
-   buffer[2] = 0x0;
-   error = (error ? error : m_device.write(buffer, 3));
-   buffer[0] = 0x4D;
-   buffer[1] = 0x0;
-   error = (error ? error : m_device.write(buffer, 2));
-   buffer[0] = 0x55;
-   buffer[1] = 0x44;
-   error = (error ? error : m_device.write(buffer, 2));
-   buffer[0] = 0x41;
-   buffer[1] = 0x4;
-   error = (error ? error : m_device.write(buffer, 2));
+      {TUNER_OP_WRITE, demod_config, 2, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 2, 2, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 4, 3, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 7, 3, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 10, 2, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 12, 3, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 15, 3, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 18, 2, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 20, 2, NULL, 0},
+      {TUNER_OP_WRITE, demod_config + 22, 2, NULL, 0}
+   };
+   error = (error ? error : m_device.submit(demod_config_ops, sizeof(demod_config_ops) / sizeof(demod_config_ops[0])));
 
    buffer[0] = 0x80;
    error = (error ? error : read_microcontroller(buffer, 2));
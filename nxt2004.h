@@ -29,8 +29,9 @@
 #define __NXT_2004_H__
 
 #include "dvb_driver.h"
+#include "tuner_firmware_broadcast.h"
 
-class nxt2004 : public dvb_driver
+class nxt2004 : public dvb_driver, public tuner_firmware_target
 {
    public:
       nxt2004(
@@ -58,6 +59,8 @@ class nxt2004 : public dvb_driver
 
       static int enable_tuner(tuner_device &device, tuner_source source);
 
+      virtual int load_firmware(tuner_firmware &fw);
+
    protected:
 
       int init_microcontroller(void);
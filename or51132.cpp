@@ -41,6 +41,9 @@ using namespace std;
 #define OR51132_VSB_CONFIG_KEY "OR51132_VSB_FW"
 #define OR51132_QAM_CONFIG_KEY "OR51132_QAM_FW"
 
+static tuner_config_key or51132_vsb_config_key(OR51132_VSB_CONFIG_KEY);
+static tuner_config_key or51132_qam_config_key(OR51132_QAM_CONFIG_KEY);
+
 #define OR51132_MODE_UNKNOWN  0x00
 #define OR51132_MODE_VSB      0x06
 #define OR51132_MODE_QAM64    0x43
@@ -174,7 +177,7 @@ int or51132::set_channel(const dvb_channel &channel, dvb_interface &interface)
    }
    if (m_mode == OR51132_MODE_VSB)
    {
-      const char *vsb_fw = m_config.get_string(OR51132_VSB_CONFIG_KEY);
+      const char *vsb_fw = m_config.get_string(or51132_vsb_config_key);
       if (vsb_fw == NULL)
       {
          LIBTUNERERR << "VSB firmware file not configured" << endl;
@@ -185,7 +188,7 @@ int or51132::set_channel(const dvb_channel &channel, dvb_interface &interface)
    }
    else
    {
-      const char *qam_fw = m_config.get_string(OR51132_QAM_CONFIG_KEY);
+      const char *qam_fw = m_config.get_string(or51132_qam_config_key);
       if (qam_fw == NULL)
       {
          LIBTUNERERR << "QAM firmware file not configured" << endl;
@@ -99,17 +99,20 @@ int pll_driver::start(uint32_t timeout_ms)
       return 0;
    }
    int error = 0;
-   if (m_buffer[4] != PLL_IGNORE_AUX)
    {
-      uint8_t aux_buffer[2];
-      aux_buffer[0] = (m_buffer[2] & 0xC7) | 0x18;
-      aux_buffer[1] = m_buffer[4];
-      if ((error = m_device.write(aux_buffer, 2)))
+      tuner_device::bus_lock lock(m_device);
+      if (m_buffer[4] != PLL_IGNORE_AUX)
       {
-         return error;
-      }   
+         uint8_t aux_buffer[2];
+         aux_buffer[0] = (m_buffer[2] & 0xC7) | 0x18;
+         aux_buffer[1] = m_buffer[4];
+         if ((error = m_device.write(aux_buffer, 2)))
+         {
+            return error;
+         }   
+      }
+      error = m_device.write(m_buffer, 4);
    }
-   error = m_device.write(m_buffer, 4);
    if (!error)
    {
       uint32_t time_slept = 0;
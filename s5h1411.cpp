@@ -163,56 +163,12 @@ s5h1411::s5h1411(
    }
    if (!error)
    {
-      uint8_t output_mode[3];
-      output_mode[0] = 0xBD;
-      error = m_device.transact(output_mode, 1, &(output_mode[1]), 2);
-      if (!error)
-      {
-         if ((input == DVB_INPUT_SERIAL) && !(output_mode[1] & 0x01))
-         {
-            output_mode[1] |= 0x01;
-            error = m_device.write(output_mode, 3);
-         }
-         else if ((input != DVB_INPUT_SERIAL) && (output_mode[1] & 0x01))
-         {
-            output_mode[1] &= 0xFE;
-            error = m_device.write(output_mode, 3);
-         }
-      }
+      error = m_device.update_bits16(0xBD, 0x0100, ((input == DVB_INPUT_SERIAL) ? 0x0100 : 0x0000));
    }
    error = (error ? error : set_inversion());
    error = (error ? error : set_ifreq(vsb_ifreq_hz));
-   if (!error)
-   {
-      uint8_t gpio_config[3];
-      gpio_config[0] = 0xE0;
-      error = m_device.transact(gpio_config, 1, &(gpio_config[1]), 2);
-      if (!error)
-      {
-         if ((gpio == S5H1411_GPIO_ENABLE) && !(gpio_config[2] & 0x2))
-         {
-            gpio_config[2] |= 0x2;
-            error = m_device.write(gpio_config, 3);
-         }
-         else if ((gpio == S5H1411_GPIO_DISABLE) && (gpio_config[2] & 0x02))
-         {
-            gpio_config[2] &= 0xFD;
-            error = m_device.write(gpio_config, 3);
-         }
-      }
-   }
-   if (!error)
-   {
-      uint8_t timing[3];
-      timing[0] = 0xBE;
-      error = m_device.transact(timing, 1, &(timing[1]), 2);
-      if (!error)
-      {
-         timing[1] &= 0xCF;
-         timing[1] |= (clock << 4);
-         error = m_device.write(timing, 3);
-      }
-   }
+   error = (error ? error : m_device.update_bits16(0xE0, 0x0002, ((gpio == S5H1411_GPIO_ENABLE) ? 0x0002 : 0x0000)));
+   error = (error ? error : m_device.update_bits16(0xBE, 0x3000, (uint16_t)clock << 12));
    error = (error ? error : soft_reset());
    error = (error ? error : i2c_gate(0x01));
 }
@@ -245,22 +201,7 @@ int s5h1411::i2c_gate(uint8_t value)
 
 int s5h1411::set_inversion(void)
 {
-   uint8_t inversion[3];
-   inversion[0] = 0x24;
-   int error = m_device.transact(inversion, 1, &(inversion[1]), 2);
-   if (error)
-   {
-      return error;
-   }
-   if (m_inversion == DVB_INVERSION_ON)
-   {
-      inversion[1] |= 0x10;
-   }
-   else
-   {
-      inversion[1] &= 0xEF;
-   }
-   return m_device.write(inversion, sizeof(inversion));
+   return m_device.update_bits16(0x24, 0x1000, ((m_inversion == DVB_INVERSION_ON) ? 0x1000 : 0x0000));
 }
 
 int s5h1411::set_ifreq(s5h1411_if_t ifreq_hz)
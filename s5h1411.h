@@ -29,6 +29,7 @@
 #define __S5H1411_H__
 
 #include "dvb_driver.h"
+#include "tuner_gate.h"
 
 enum s5h1411_gpio_t
 {
@@ -54,7 +55,8 @@ enum s5h1411_clock_t
 };
 
 class s5h1411
-   : public dvb_driver
+   : public dvb_driver,
+     public tuner_gate
 {
    
    public:
@@ -81,6 +83,16 @@ class s5h1411
       virtual void stop(void);
 
       virtual void reset(void);
+
+      virtual int gate_open(void)
+      {
+         return i2c_gate(0x01);
+      }
+
+      virtual int gate_close(void)
+      {
+         return i2c_gate(0x00);
+      }
       
    private:
    
@@ -74,6 +74,7 @@ void tda18271::initialize(int &error)
    {
       return;
    }
+   tuner_device::bus_lock lock(m_device);
    init_regs(error);
    if (m_version == TDA18271_VER_2)
    {
@@ -98,11 +99,13 @@ void tda18271::write_regs(tda18271_reg_t start, tda18271_reg_t end, int &error)
       error = EINVAL;
       return;
    }
-   uint8_t regbuf[TDA18271_NUM_REGS + 1];
-   regbuf[0] = start;
-   size_t count = end - start + 1;
-   memcpy(regbuf + 1, m_regs + start, count);
-   error = m_device.write(regbuf, count + 1);
+   uint8_t addr = start;
+   struct iovec iov[2];
+   iov[0].iov_base = &addr;
+   iov[0].iov_len = sizeof(addr);
+   iov[1].iov_base = m_regs + start;
+   iov[1].iov_len = end - start + 1;
+   error = m_device.write(iov, 2);
 }
       
 void tda18271::read_regs(tda18271_reg_t start, tda18271_reg_t end, int &error)
@@ -1772,6 +1775,7 @@ void tda18271::set_rf(uint32_t freq_hz, tda18271_interface &ifc, int &error)
    {
       return;
    }
+   tuner_device::bus_lock lock(m_device);
    if (m_version == TDA18271_VER_1)
    {
       rf_tracking_filter_calibration(freq_hz, error);
@@ -31,7 +31,8 @@
  
 tda8295::tda8295(tuner_config &config, tuner_device &device, int &error)
    : tuner_driver(config, device),
-     avb_driver(config, device)
+     avb_driver(config, device),
+     m_gate_open(false)
 {
    if (error)
    {
@@ -78,33 +79,19 @@ void tda8295::agc_enable(bool enable, int &error)
    {
       return;
    }
-   uint8_t agc[2];
-   agc[0] = 0x02;
-   error = m_device.transact(agc, 1, agc + 1, 1);
-   if (error)
-   {
-      return;
-   }
-   if (enable)
-   {
-      agc[1] &= 0xBF;
-   }
-   else
-   {
-      agc[1] |= 0x40;
-   }
-   error = m_device.write(agc, sizeof(agc));
+   error = m_device.update_bits(0x02, 0x40, (enable ? 0x00 : 0x40));
 }
 
 void tda8295::i2c_gate_open(int &error)
 {
-   if (error)
+   if (error || m_gate_open)
    {
       return;
    }
    static const uint8_t i2c_gate[] = {0x45, 0xC1};
    error = m_device.write(i2c_gate, sizeof(i2c_gate));
    usleep(20000);
+   m_gate_open = !error;
 }
 
 void tda8295::i2c_gate_close(int &error)
@@ -113,6 +100,9 @@ void tda8295::i2c_gate_close(int &error)
    {
       return;
    }
+   tuner_device::bus_lock lock(m_device);
+   // Even a failed sequence may have left the gate closed.
+   m_gate_open = false;
    uint8_t i2c_gate[3];
    i2c_gate[0] = 0x46;
    error = m_device.transact(i2c_gate, 1, i2c_gate + 1, 1);
@@ -132,6 +122,20 @@ void tda8295::i2c_gate_close(int &error)
    }
 }
 
+int tda8295::gate_open(void)
+{
+   int error = 0;
+   i2c_gate_open(error);
+   return error;
+}
+
+int tda8295::gate_close(void)
+{
+   int error = 0;
+   i2c_gate_close(error);
+   return error;
+}
+
 void tda8295::do_reset(int &error)
 {
    if (error)
@@ -144,6 +148,8 @@ void tda8295::do_reset(int &error)
    {
       static const uint8_t power[] = {0x30, 0x03};
       error = m_device.write(power, sizeof(power));
+      // Powering down doesn't preserve the gate setting.
+      m_gate_open = false;
    }
 }
 
@@ -29,9 +29,11 @@
 #define __TDA8295_H__
 
 #include "avb_driver.h"
+#include "tuner_gate.h"
 
 class tda8295
-   : public avb_driver
+   : public avb_driver,
+     public tuner_gate
 {
    public:
    
@@ -46,6 +48,10 @@ class tda8295
       virtual void reset(void);
       
       virtual int set_channel(const avb_channel &channel);
+
+      virtual int gate_open(void);
+
+      virtual int gate_close(void);
       
    private:
    
@@ -54,6 +60,8 @@ class tda8295
       void agc_enable(bool enable, int &error);
       void do_reset(int &error);
 
+      bool m_gate_open;
+
 };
 
 #endif
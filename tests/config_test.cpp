@@ -0,0 +1,293 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <list>
+#include "tuner_config.h"
+#include "tuner_config_compiled.h"
+
+static int failures = 0;
+
+static void check(bool cond, const char *what)
+{
+   if (!cond)
+   {
+      fprintf(stderr, "FAIL: %s\n", what);
+      ++failures;
+   }
+}
+
+static tuner_config_key test_key("Config_Test.Value");
+
+struct reader_args
+{
+   tuner_config *config;
+   volatile bool stop;
+   unsigned long bad;
+};
+
+static void *reader(void *arg)
+{
+   reader_args *args = static_cast<reader_args*>(arg);
+   while (!__atomic_load_n(&args->stop, __ATOMIC_ACQUIRE))
+   {
+      int by_key = args->config->get_number<int>(test_key, -1);
+      int by_name = args->config->get_number<int>("config_test.value", -1);
+      const char *str = args->config->get_string(test_key);
+      if ((by_key < 0) || (by_name < 0) || (str == NULL) || (atoi(str) < 0))
+      {
+         ++args->bad;
+      }
+      sched_yield();
+   }
+   return NULL;
+}
+
+// Readers never see a missing or torn value while a writer replaces it.
+static void test_concurrent_readers(void)
+{
+   tuner_config base, chained;
+   base.add_config(chained);
+   chained.load_string("config_test.value = 0\nother = 1\n");
+   reader_args args = {&base, false, 0};
+   pthread_t threads[4];
+   for (int i = 0; i < 4; ++i)
+   {
+      pthread_create(&threads[i], NULL, reader, &args);
+   }
+   char buf[32];
+   for (int i = 0; i < 2000; ++i)
+   {
+      snprintf(buf, sizeof(buf), "%d", i);
+      chained.set_string("CONFIG_TEST.VALUE", buf);
+      if ((i % 100) == 0)
+      {
+         chained.load_string("other = 2\n");
+      }
+   }
+   __atomic_store_n(&args.stop, true, __ATOMIC_RELEASE);
+   for (int i = 0; i < 4; ++i)
+   {
+      pthread_join(threads[i], NULL);
+   }
+   check(args.bad == 0, "reader saw a missing value");
+   check(base.get_number<int>(test_key) == 1999, "last value visible through chain");
+}
+
+// A string returned by get_string() survives the key being set again.
+static void test_retirement(void)
+{
+   tuner_config config;
+   config.set_string("retired", "first");
+   const char *first = config.get_string("retired");
+   for (int i = 0; i < (TUNER_CONFIG_RETIRED_VALUES / 2); ++i)
+   {
+      config.set_string("retired", "later");
+   }
+   check((first != NULL) && (strcmp(first, "first") == 0), "retired value kept");
+   for (int i = 0; i < (TUNER_CONFIG_RETIRED_VALUES * 8); ++i)
+   {
+      config.load_string("retired = loaded\nother = x\n");
+   }
+   const char *str = config.get_string("retired");
+   check((str != NULL) && (strcmp(str, "loaded") == 0), "value after many loads");
+}
+
+static tuner_config_key scoped_key("Gain");
+
+// A scope sees its prefixed keys first, and the parent's values otherwise.
+static void test_scopes(void)
+{
+   tuner_config base, chained;
+   base.add_config(chained);
+   base.load_string("gain = 1\nlna = 2\n");
+   int error = 0;
+   tuner_config scope(base, "Tuner1.", error);
+   tuner_config nested(scope, "fe0.", error);
+   check(error == 0, "scope constructor");
+   check(scope.get_number<int>(scoped_key) == 1, "unscoped value through scope");
+   chained.set_string("tuner1.gain", "3");
+   check(scope.get_number<int>(scoped_key) == 3, "scoped value overrides");
+   check(scope.get_number<int>("gain") == 3, "scoped value by name");
+   check(base.get_number<int>(scoped_key) == 1, "parent unaffected");
+   check(nested.get_number<int>(scoped_key) == 3, "nested scope sees outer override");
+   chained.set_string("tuner1.fe0.gain", "4");
+   check(nested.get_number<int>(scoped_key) == 4, "nested scope override");
+   tuner_config_key lna("LNA");
+   check(scope.get_number<int>(lna) == 2, "key interned after scope");
+   base.load_string("lna = 5\n");
+   check(nested.get_number<int>(lna) == 5, "parent change seen through scopes");
+   chained.set_string("tuner1.lna", "6");
+   check((scope.get_number<int>(lna) == 6) && (nested.get_number<int>(lna) == 6), "override added after scope");
+   check(base.get_number<int>(lna) == 5, "parent keeps its own value");
+}
+
+// Compiled files are searched in place, newest first, over earlier values.
+static void test_compiled(void)
+{
+   char first[] = "/tmp/config_test.XXXXXX";
+   char second[] = "/tmp/config_test.XXXXXX";
+   int fd1 = mkstemp(first);
+   int fd2 = mkstemp(second);
+   check((fd1 >= 0) && (fd2 >= 0), "mkstemp");
+   if ((fd1 < 0) || (fd2 < 0))
+   {
+      return;
+   }
+   close(fd1);
+   close(fd2);
+   tuner_config source;
+   source.load_string("a = 1\nb = 2\nc = 3\n");
+   check(source.save_compiled(first) == 0, "save first");
+   source.load_string("b = 20\nd = 4\n");
+   check(source.save_compiled(second) == 0, "save second");
+   tuner_config config;
+   tuner_config_key b_key("b");
+   config.set_string("a", "set before");
+   config.set_string("e", "5");
+   check(config.load_compiled(first) == 0, "load first");
+   check(config.get_number<int>("a") == 1, "compiled value replaces earlier one");
+   check(config.get_number<int>(b_key) == 2, "compiled value by key");
+   check(config.get_number<int>("e") == 5, "other values kept");
+   config.set_string("c", "30");
+   check(config.get_number<int>("c") == 30, "later value replaces compiled one");
+   check(config.load_compiled(second) == 0, "load second");
+   check(config.get_number<int>(b_key) == 20, "newer compiled file first");
+   check(config.get_number<int>("a") == 1, "older compiled file still searched");
+   check(config.get_number<int>("c") == 3, "compiled values replace earlier ones");
+   check(config.save_compiled(first) == 0, "save merged");
+   tuner_config merged;
+   check(merged.load_compiled(first) == 0, "load merged");
+   check((merged.get_number<int>("a") == 1) && (merged.get_number<int>("b") == 20) &&
+         (merged.get_number<int>("d") == 4) && (merged.get_number<int>("e") == 5), "merged values");
+   // Keys out of order are rejected rather than searched.
+   tuner_config_compiled_header header = {TUNER_CONFIG_COMPILED_MAGIC, TUNER_CONFIG_COMPILED_VERSION, 2, 8};
+   tuner_config_compiled_key keys[2];
+   memset(keys, 0, sizeof(keys));
+   keys[0].key_offset = 4;
+   keys[0].value_offset = 6;
+   keys[1].key_offset = 0;
+   keys[1].value_offset = 2;
+   FILE *stream = fopen(second, "w");
+   check((stream != NULL) && (fwrite(&header, sizeof(header), 1, stream) == 1) &&
+         (fwrite(keys, sizeof(keys), 1, stream) == 1) && (fwrite("a\0001\000b\0002", 8, 1, stream) == 1), "write unsorted");
+   if (stream != NULL)
+   {
+      fclose(stream);
+   }
+   check(merged.load_compiled(second) == EINVAL, "unsorted keys rejected");
+   unlink(first);
+   unlink(second);
+}
+
+class test_listener : public tuner_config_listener
+{
+   public:
+
+      test_listener(void) : calls(0) {}
+
+      virtual void config_changed(tuner_config &config, const std::list<std::string> &changed)
+      {
+         ++calls;
+         keys = changed;
+      }
+
+      int calls;
+      std::list<std::string> keys;
+};
+
+// Listeners hear about changes made through the chain, with the keys changed.
+static void test_listeners(void)
+{
+   tuner_config base, chained;
+   test_listener listener;
+   base.add_listener(listener);
+   base.add_config(chained);
+   check(listener.calls == 0, "no notification for an empty chain");
+   chained.set_string("A", "1");
+   check((listener.calls == 1) && (listener.keys.size() == 1) && (listener.keys.front() == "a"), "set through chain");
+   chained.set_string("a", "1");
+   check(listener.calls == 1, "no notification for an unchanged value");
+   chained.load_string("a = 2\nb = 3\n");
+   check((listener.calls == 2) && (listener.keys.size() == 2), "load notifies each changed key");
+   base.remove_config(chained);
+   check((listener.calls == 3) && (listener.keys.size() == 2), "removing a config notifies its keys");
+   base.remove_listener(listener);
+}
+
+// Reloading a file changes only the keys whose values still come from it.
+static void test_reload(void)
+{
+   char path[] = "/tmp/config_test.XXXXXX";
+   int fd = mkstemp(path);
+   check(fd >= 0, "mkstemp");
+   if (fd < 0)
+   {
+      return;
+   }
+   static const char first[] = "kept = 1\nchanged = 2\nremoved = 3\noverridden = 4\n";
+   static const char second[] = "kept = 1\nchanged = 7\nchanged = 20\nadded = 5\noverridden = 40\n";
+   check(write(fd, first, sizeof(first) - 1) == (ssize_t)(sizeof(first) - 1), "write config");
+   tuner_config config;
+   test_listener listener;
+   check(config.load_file(path) == 0, "load_file");
+   config.set_string("overridden", "set");
+   config.add_listener(listener);
+   check((ftruncate(fd, 0) == 0) && (pwrite(fd, second, sizeof(second) - 1, 0) == (ssize_t)(sizeof(second) - 1)), "rewrite config");
+   close(fd);
+   check(config.reload_file(path) == 0, "reload_file");
+   unlink(path);
+   check(config.get_number<int>("kept") == 1, "unchanged key");
+   check(config.get_number<int>("changed") == 20, "changed key");
+   check(config.get_string("removed") == NULL, "removed key");
+   check(config.get_number<int>("added") == 5, "added key");
+   check(strcmp(config.get_string("overridden"), "set") == 0, "set_string value kept");
+   check((listener.calls == 1) && (listener.keys.size() == 3), "reload notifies each changed key");
+   config.remove_listener(listener);
+}
+
+int main(void)
+{
+   test_concurrent_readers();
+   test_retirement();
+   test_scopes();
+   test_compiled();
+   test_listeners();
+   test_reload();
+   if (failures == 0)
+   {
+      printf("config_test: all tests passed\n");
+   }
+   return ((failures == 0) ? 0 : 1);
+}
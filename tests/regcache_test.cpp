@@ -0,0 +1,198 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/errno.h>
+#include <sys/uio.h>
+#include <vector>
+#include "tuner_config.h"
+#include "tuner_sim_models.h"
+#include "tuner_regcache_device.h"
+
+static int failures = 0;
+
+static void check(bool cond, const char *what)
+{
+   if (!cond)
+   {
+      fprintf(stderr, "FAIL: %s\n", what);
+      ++failures;
+   }
+}
+
+// Records every register write that reaches the simulated chip.
+class logging_regmap
+   : public tuner_sim_regmap
+{
+   public:
+
+      logging_regmap(size_t addr_bytes, size_t value_bytes, bool auto_increment)
+         : tuner_sim_regmap(addr_bytes, value_bytes, auto_increment)
+      {}
+
+      size_t count(uint16_t reg, uint16_t value)
+      {
+         size_t matches = 0;
+         for (size_t i = 0; i < m_log.size(); ++i)
+         {
+            if ((m_log[i].first == reg) && (m_log[i].second == value))
+            {
+               ++matches;
+            }
+         }
+         return matches;
+      }
+
+      std::vector<std::pair<uint16_t, uint16_t> > m_log;
+
+   protected:
+
+      virtual void reg_written(uint16_t reg, uint16_t value)
+      {
+         m_log.push_back(std::make_pair(reg, value));
+      }
+};
+
+// A register written twice in one array, e.g. an s5h1411 soft reset
+// followed by its release, must end up with the last value every time.
+static void test_array_rewrite(void)
+{
+   tuner_config config;
+   logging_regmap model(1, 2, false);
+   tuner_sim_device sim(config, model, TUNER_SIM_TIMING_I2C_400KHZ, false);
+   int error = 0;
+   tuner_regcache_device cache(config, sim, 1, 2, false, error);
+   check(error == 0, "constructor");
+   static const uint8_t reset[] = {0xF7, 0x00, 0x00, 0xF7, 0x00, 0x01};
+   for (int pass = 0; pass < 3; ++pass)
+   {
+      check(cache.write_array(reset, 3, sizeof(reset)) == 0, "write_array");
+      check(model.get_reg(0xF7) == 1, "array rewrite of same register");
+   }
+   check((model.count(0xF7, 0) == 3) && (model.count(0xF7, 1) == 3), "array pulse reached device");
+}
+
+static void test_submit_rewrite(void)
+{
+   tuner_config config;
+   logging_regmap model(1, 2, false);
+   tuner_sim_device sim(config, model, TUNER_SIM_TIMING_I2C_400KHZ, false);
+   int error = 0;
+   tuner_regcache_device cache(config, sim, 1, 2, false, error);
+   check(error == 0, "constructor");
+   static const uint8_t assert_reset[] = {0xF7, 0x00, 0x00};
+   static const uint8_t release_reset[] = {0xF7, 0x00, 0x01};
+   tuner_op ops[2];
+   memset(ops, 0, sizeof(ops));
+   ops[0].type = TUNER_OP_WRITE;
+   ops[0].write_buffer = assert_reset;
+   ops[0].write_size = sizeof(assert_reset);
+   ops[1] = ops[0];
+   ops[1].write_buffer = release_reset;
+   for (int pass = 0; pass < 3; ++pass)
+   {
+      check(cache.submit(ops, 2) == 0, "submit");
+      check(model.get_reg(0xF7) == 1, "submit rewrite of same register");
+   }
+   check((model.count(0xF7, 0) == 3) && (model.count(0xF7, 1) == 3), "submitted pulse reached device");
+}
+
+// Volatile registers are written every time; others only when they change.
+static void test_volatile(void)
+{
+   tuner_config config;
+   logging_regmap model(1, 1, true);
+   tuner_sim_device sim(config, model, TUNER_SIM_TIMING_I2C_400KHZ, false);
+   int error = 0;
+   tuner_regcache_device cache(config, sim, 1, 1, true, error);
+   check(error == 0, "constructor");
+   cache.set_volatile(0x10, 0x10);
+   static const uint8_t strobe[] = {0x10, 0x01};
+   static const uint8_t plain[] = {0x11, 0x01};
+   size_t written = 0;
+   for (int pass = 0; pass < 3; ++pass)
+   {
+      check((cache.write(strobe, sizeof(strobe), written) == 0) && (written == sizeof(strobe)), "volatile write");
+      check((cache.write(plain, sizeof(plain), written) == 0) && (written == sizeof(plain)), "plain write");
+   }
+   check(model.count(0x10, 1) == 3, "volatile writes reached device");
+   check(model.count(0x11, 1) == 1, "unchanged writes dropped");
+}
+
+// Gathered writes with 2-byte addresses pass through and drop the cached values.
+static void test_gathered(void)
+{
+   tuner_config config;
+   logging_regmap model(2, 1, true);
+   tuner_sim_device sim(config, model, TUNER_SIM_TIMING_I2C_400KHZ, false);
+   int error = 0;
+   tuner_regcache_device cache(config, sim, 2, 1, true, error);
+   check(error == 0, "constructor");
+   static const uint8_t single[] = {0x01, 0x20, 0x05};
+   static uint8_t addr[] = {0x01, 0x20};
+   static uint8_t data[] = {0x05, 0x06};
+   size_t written = 0;
+   check(cache.write(single, sizeof(single), written) == 0, "cached write");
+   struct iovec iov[2];
+   iov[0].iov_base = addr;
+   iov[0].iov_len = sizeof(addr);
+   iov[1].iov_base = data;
+   iov[1].iov_len = sizeof(data);
+   check(cache.write(iov, 2) == 0, "gathered write");
+   check((model.count(0x120, 5) == 2) && (model.count(0x121, 6) == 1), "gathered write reached device");
+   check(cache.write(single, sizeof(single), written) == 0, "write after gathered write");
+   check(model.count(0x120, 5) == 3, "gathered write invalidated cache");
+}
+
+static void test_sizes(void)
+{
+   tuner_config config;
+   tuner_sim_regmap model(1, 1, false);
+   tuner_sim_device sim(config, model, TUNER_SIM_TIMING_I2C_400KHZ, false);
+   static const size_t sizes[][2] = {{0, 1}, {3, 1}, {1, 0}, {1, 4}};
+   for (size_t i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); ++i)
+   {
+      int error = 0;
+      tuner_regcache_device cache(config, sim, sizes[i][0], sizes[i][1], false, error);
+      check(error == EINVAL, "unsupported register size rejected");
+   }
+}
+
+int main(void)
+{
+   test_array_rewrite();
+   test_submit_rewrite();
+   test_volatile();
+   test_gathered();
+   test_sizes();
+   if (failures == 0)
+   {
+      printf("regcache_test: all tests passed\n");
+   }
+   return ((failures == 0) ? 0 : 1);
+}
@@ -0,0 +1,151 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "tuner_bus.h"
+
+tuner_bus::tuner_bus(tuner_config &config, const char *devnode, int &error)
+   : m_fd(-1),
+     m_depth(0),
+     m_owner(NULL)
+{
+   pthread_mutex_init(&m_lock, NULL);
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&m_cond, &attr);
+   pthread_condattr_destroy(&attr);
+   for (int i = 0; i < TUNER_BUS_NUM_PRIORITIES; ++i)
+   {
+      m_next_ticket[i] = 0;
+      m_now_serving[i] = 0;
+   }
+   if (error)
+   {
+      return;
+   }
+   if ((m_fd = open(devnode, O_RDWR)) < 0)
+   {
+      LIBTUNERERR << "Unable to open bus " << devnode << ": " << strerror(errno) << std::endl;
+      error = ENOENT;
+   }
+}
+
+tuner_bus::~tuner_bus(void)
+{
+   if (m_fd >= 0)
+   {
+      close(m_fd);
+   }
+   pthread_cond_destroy(&m_cond);
+   pthread_mutex_destroy(&m_lock);
+}
+
+bool tuner_bus::higher_priority_waiting(tuner_bus_priority priority)
+{
+   for (int i = priority + 1; i < TUNER_BUS_NUM_PRIORITIES; ++i)
+   {
+      if (m_next_ticket[i] != m_now_serving[i])
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+/*
+ * A waiter that times out leaves its ticket behind; it is skipped when its
+ * turn comes so the waiters queued after it still get served.
+ */
+void tuner_bus::skip_abandoned(tuner_bus_priority priority)
+{
+   std::vector<unsigned int> &abandoned = m_abandoned[priority];
+   std::vector<unsigned int>::iterator it;
+   while ((it = std::find(abandoned.begin(), abandoned.end(), m_now_serving[priority])) != abandoned.end())
+   {
+      abandoned.erase(it);
+      ++m_now_serving[priority];
+   }
+}
+
+bool tuner_bus::acquire(const void *owner, tuner_bus_priority priority)
+{
+   bool switched = false;
+   acquire(owner, priority, 0, switched);
+   return switched;
+}
+
+int tuner_bus::acquire(const void *owner, tuner_bus_priority priority, uint64_t deadline, bool &switched)
+{
+   struct timespec abstime;
+   abstime.tv_sec = (time_t)(deadline / 1000000);
+   abstime.tv_nsec = (long)((deadline % 1000000) * 1000);
+   pthread_mutex_lock(&m_lock);
+   if ((m_depth == 0) || !pthread_equal(m_holder, pthread_self()))
+   {
+      unsigned int ticket = m_next_ticket[priority]++;
+      while ((m_depth != 0) || (ticket != m_now_serving[priority]) || higher_priority_waiting(priority))
+      {
+         if (deadline == 0)
+         {
+            pthread_cond_wait(&m_cond, &m_lock);
+         }
+         else if (pthread_cond_timedwait(&m_cond, &m_lock, &abstime) == ETIMEDOUT)
+         {
+            m_abandoned[priority].push_back(ticket);
+            skip_abandoned(priority);
+            pthread_cond_broadcast(&m_cond);
+            pthread_mutex_unlock(&m_lock);
+            return ETIMEDOUT;
+         }
+      }
+      ++m_now_serving[priority];
+      skip_abandoned(priority);
+      m_holder = pthread_self();
+   }
+   ++m_depth;
+   switched = (owner != m_owner);
+   m_owner = owner;
+   pthread_mutex_unlock(&m_lock);
+   return 0;
+}
+
+void tuner_bus::release(void)
+{
+   pthread_mutex_lock(&m_lock);
+   if ((m_depth > 0) && (--m_depth == 0))
+   {
+      pthread_cond_broadcast(&m_cond);
+   }
+   pthread_mutex_unlock(&m_lock);
+}
@@ -0,0 +1,91 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_BUS_H__
+#define __TUNER_BUS_H__
+
+#include <pthread.h>
+#include <vector>
+#include "tuner_config.h"
+
+enum tuner_bus_priority
+{
+   TUNER_BUS_PRIORITY_BULK = 0,
+   TUNER_BUS_PRIORITY_NORMAL,
+   TUNER_BUS_PRIORITY_LATENCY,
+   TUNER_BUS_NUM_PRIORITIES
+};
+
+/*
+ * Owns the device node for a physical bus shared by several devices and
+ * serializes their access to it.  Waiters are served in FIFO order within a
+ * priority class, and higher classes always go first, so short operations
+ * can run between the chunks of a long transfer.  The bus may be acquired
+ * recursively by the thread that holds it.
+ */
+class tuner_bus
+{
+   public:
+
+      tuner_bus(tuner_config &config, const char *devnode, int &error);
+
+      virtual ~tuner_bus(void);
+
+      int fd(void)
+      {
+         return m_fd;
+      }
+
+      // Returns true if the bus was last used on behalf of a different owner.
+      bool acquire(const void *owner, tuner_bus_priority priority);
+
+      /*
+       * As above, but gives up with ETIMEDOUT once deadline (in
+       * CLOCK_MONOTONIC microseconds, 0 for none) passes.
+       */
+      int acquire(const void *owner, tuner_bus_priority priority, uint64_t deadline, bool &switched);
+
+      void release(void);
+
+   private:
+
+      bool higher_priority_waiting(tuner_bus_priority priority);
+
+      void skip_abandoned(tuner_bus_priority priority);
+
+      int m_fd;
+      pthread_mutex_t m_lock;
+      pthread_cond_t m_cond;
+      pthread_t m_holder;
+      unsigned int m_depth;
+      const void *m_owner;
+      unsigned int m_next_ticket[TUNER_BUS_NUM_PRIORITIES];
+      unsigned int m_now_serving[TUNER_BUS_NUM_PRIORITIES];
+      std::vector<unsigned int> m_abandoned[TUNER_BUS_NUM_PRIORITIES];
+};
+
+#endif
@@ -27,15 +27,132 @@
 
 #include <sys/errno.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
-#include <fstream>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
 #include "tuner_config.h"
+#include "tuner_config_compiled.h"
 
 using namespace std;
 
 #define WHITESPACE " \t"
 #define DELIMS WHITESPACE"="
 
+/*
+ * Contents of a config file.  Mapped when loading, since nothing else is
+ * expected to be writing it then; read into memory when reloading a file
+ * that may be rewritten, and so truncated, under us.
+ */
+class config_file
+{
+   public:
+
+      config_file(const char *filename, bool map, int &error)
+         : m_data(NULL),
+           m_size(0),
+           m_mapped(false)
+      {
+         int fd = open(filename, O_RDONLY);
+         if (fd < 0)
+         {
+            error = errno;
+            return;
+         }
+         struct stat st;
+         if (fstat(fd, &st) < 0)
+         {
+            error = errno;
+         }
+         else if (map && (st.st_size > 0))
+         {
+            void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+            {
+               error = errno;
+            }
+            else
+            {
+               m_data = static_cast<const char*>(data);
+               m_size = (size_t)st.st_size;
+               m_mapped = true;
+            }
+         }
+         else if (!map)
+         {
+            error = read_all(fd, (size_t)st.st_size);
+         }
+         close(fd);
+      }
+
+      ~config_file(void)
+      {
+         if (m_mapped)
+         {
+            munmap(const_cast<char*>(m_data), m_size);
+         }
+      }
+
+      const char *data(void)
+      {
+         return m_data;
+      }
+
+      size_t size(void)
+      {
+         return m_size;
+      }
+
+   private:
+
+      int read_all(int fd, size_t size_hint)
+      {
+         try
+         {
+            m_buffer.resize(size_hint + 1);
+            for (;;)
+            {
+               ssize_t len = read(fd, &m_buffer[m_size], m_buffer.size() - m_size);
+               if (len < 0)
+               {
+                  if (errno == EINTR)
+                  {
+                     continue;
+                  }
+                  return errno;
+               }
+               if (len == 0)
+               {
+                  break;
+               }
+               m_size += (size_t)len;
+               if (m_size == m_buffer.size())
+               {
+                  m_buffer.resize(m_buffer.size() * 2);
+               }
+            }
+         }
+         catch(...)
+         {
+            return ENOMEM;
+         }
+         m_data = &m_buffer[0];
+         return 0;
+      }
+
+      const char *m_data;
+      size_t m_size;
+      bool m_mapped;
+      vector<char> m_buffer;
+};
+
+static bool is_whitespace(char c)
+{
+   return ((c == ' ') || (c == '\t'));
+}
+
 namespace libtuner_config
 {
    static ostream& default_log(std::ostream *stream)
@@ -65,168 +182,2492 @@ namespace libtuner_config
       errfunc = func;
    }
 }
+/*
+ * Readers of config tables take no lock.  They announce themselves in the
+ * counter for the current epoch's parity, and re-check the epoch so a
+ * concurrent flip can't miss them.  A writer that has unpublished a table
+ * or value flips the epoch and waits for the old parity to drain, after
+ * which nothing can still be reading it.
+ */
+static unsigned int rcu_epoch = 0;
+static unsigned int rcu_readers[2] = {0, 0};
+static pthread_mutex_t rcu_lock = PTHREAD_MUTEX_INITIALIZER;
 
-int tuner_config::load(istream &stream, char line_delim)
+static unsigned int rcu_read_lock(void)
 {
-   if (m_next != NULL)
+   for (;;)
    {
-      return m_next->load(stream, line_delim);  
+      unsigned int epoch = __atomic_load_n(&rcu_epoch, __ATOMIC_SEQ_CST);
+      __atomic_fetch_add(&rcu_readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&rcu_epoch, __ATOMIC_SEQ_CST) == epoch)
+      {
+         return epoch;
+      }
+      __atomic_fetch_sub(&rcu_readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
    }
-   int error = 0;
-   try
+}
+
+static void rcu_read_unlock(unsigned int epoch)
+{
+   __atomic_fetch_sub(&rcu_readers[epoch & 1], 1, __ATOMIC_SEQ_CST);
+}
+
+static void rcu_synchronize(void)
+{
+   pthread_mutex_lock(&rcu_lock);
+   unsigned int epoch = __atomic_fetch_add(&rcu_epoch, 1, __ATOMIC_SEQ_CST);
+   while (__atomic_load_n(&rcu_readers[epoch & 1], __ATOMIC_SEQ_CST) != 0)
+   {
+      sched_yield();
+   }
+   pthread_mutex_unlock(&rcu_lock);
+}
+
+extern char **environ;
+
+#define FNV_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
+// FNV-1a, continued from hash so that a prefix can be hashed once.
+static uint32_t hash_bytes(uint32_t hash, const char *data, size_t len)
+{
+   for (size_t i = 0; i < len; ++i)
+   {
+      hash = ((hash ^ (uint8_t)data[i]) * FNV_PRIME);
+   }
+   return hash;
+}
+
+static uint32_t hash_name(const char *name)
+{
+   return hash_bytes(FNV_BASIS, name, strlen(name));
+}
+
+// Copies len bytes of key lowercased, and returns the hash of the copy.
+static uint32_t lower_key(char *dst, const char *key, size_t len)
+{
+   uint32_t hash = FNV_BASIS;
+   for (size_t i = 0; i < len; ++i)
    {
-      string line;
-      int lineno = 0;
-      while (!stream.eof())
+      dst[i] = (char)tolower((unsigned char)key[i]);
+      hash = ((hash ^ (uint8_t)dst[i]) * FNV_PRIME);
+   }
+   return hash;
+}
+
+/*
+ * A key lowercased for lookup, kept on the stack unless it is unusually
+ * long, so that a lookup by name allocates nothing.
+ */
+class lowered_key
+{
+   public:
+
+      explicit lowered_key(const char *key)
+         : m_key(m_buffer),
+           m_len(strlen(key))
       {
-         getline(stream, line, line_delim);
-         ++lineno;
-         string::size_type token_begin, token_end;
-         token_begin = line.find_first_not_of(WHITESPACE);
-         if (token_begin == string::npos)
+         if (m_len >= sizeof(m_buffer))
          {
-            continue;
+            m_long.resize(m_len);
+            m_key = &m_long[0];
+         }
+         m_hash = lower_key(m_key, key, m_len);
+      }
+
+      const char *key(void) const
+      {
+         return m_key;
+      }
+
+      size_t len(void) const
+      {
+         return m_len;
+      }
+
+      uint32_t hash(void) const
+      {
+         return m_hash;
+      }
+
+   private:
+
+      lowered_key(const lowered_key&);
+
+      lowered_key &operator=(const lowered_key&);
+
+      char m_buffer[128];
+      string m_long;
+      char *m_key;
+      size_t m_len;
+      uint32_t m_hash;
+};
+
+/*
+ * The hashed key tables share one linear probe.  A slot's key is stored
+ * last when the slot is filled and never changes afterwards, so a reader
+ * that finds the key also sees the rest of the slot.  Tables are kept at
+ * most half full.  Returns the matching slot, or the empty one where the
+ * key would go.
+ */
+template <typename slot_type>
+static slot_type *probe(slot_type *slots, size_t mask, const char *key, size_t len, uint32_t hash)
+{
+   for (size_t i = (hash & mask);; i = ((i + 1) & mask))
+   {
+      const char *slot_key = __atomic_load_n(&slots[i].key, __ATOMIC_ACQUIRE);
+      if ((slot_key == NULL) ||
+          ((slots[i].hash == hash) && (slots[i].len == len) && (memcmp(slot_key, key, len) == 0)))
+      {
+         return &slots[i];
+      }
+   }
+}
+
+/*
+ * Locale-free equivalent of reading the value with operator>>: leading
+ * whitespace, an optional sign, then decimal digits with an optional
+ * fraction and exponent.  The integer form is the leading integer part.
+ */
+static void parse_value(tuner_config_value &value, const char *str)
+{
+   value.str = str;
+   value.numeric = false;
+   value.integer = 0;
+   value.real = 0.0;
+   while ((*str == ' ') || ((*str >= '\t') && (*str <= '\r')))
+   {
+      ++str;
+   }
+   bool negative = (*str == '-');
+   if ((*str == '-') || (*str == '+'))
+   {
+      ++str;
+   }
+   uint64_t integer = 0;
+   double real = 0.0;
+   for (; (*str >= '0') && (*str <= '9'); ++str)
+   {
+      integer = (integer * 10) + (uint64_t)(*str - '0');
+      real = (real * 10.0) + (double)(*str - '0');
+      value.numeric = true;
+   }
+   if (*str == '.')
+   {
+      double scale = 0.1;
+      for (++str; (*str >= '0') && (*str <= '9'); ++str, scale *= 0.1)
+      {
+         real += (scale * (double)(*str - '0'));
+         value.numeric = true;
+      }
+   }
+   if (value.numeric && ((*str == 'e') || (*str == 'E')))
+   {
+      const char *exp = str + 1;
+      bool exp_negative = (*exp == '-');
+      if ((*exp == '-') || (*exp == '+'))
+      {
+         ++exp;
+      }
+      int exponent = 0;
+      for (; (*exp >= '0') && (*exp <= '9'); ++exp)
+      {
+         if (exponent < 10000)
+         {
+            exponent = (exponent * 10) + (*exp - '0');
          }
-         if (line[token_begin] == '#')
+      }
+      for (; exponent > 0; --exponent)
+      {
+         real = (exp_negative ? (real / 10.0) : (real * 10.0));
+      }
+   }
+   value.integer = (negative ? -(int64_t)integer : (int64_t)integer);
+   value.real = (negative ? -real : real);
+}
+
+struct env_entry
+{
+   uint32_t hash;
+   const char *name;
+   tuner_config_value value;
+};
+
+/*
+ * Copy of the process environment, hashed by variable name.  Each
+ * NAME=VALUE string is copied into one block with the '=' replaced by a
+ * terminator, so names and values can be handed out directly.
+ */
+class env_snapshot
+{
+   public:
+
+      env_snapshot(void)
+      {
+         size_t count = 0, size = 0;
+         for (char **env = environ; (env != NULL) && (*env != NULL); ++env, ++count)
          {
-            continue;
+            size += strlen(*env) + 1;
          }
-         token_end = line.find_first_of(DELIMS, token_begin);
-         if (token_end == string::npos)
+         size_t table_size = 1;
+         while (table_size < (count * 2))
          {
-            LIBTUNERERR << "line " << lineno << ": Warning: skipped identifier without value" << endl;
-            continue;
+            table_size <<= 1;
          }
-         string ident = line.substr(token_begin, token_end - token_begin);
-         token_begin = line.find_first_not_of(DELIMS, token_end);
-         if (token_begin == string::npos)
+         m_block.resize(size + 1);
+         env_entry empty;
+         memset(&empty, 0, sizeof(empty));
+         m_table.resize(table_size, empty);
+         char *pos = &m_block[0];
+         for (size_t i = 0; i < count; ++i)
          {
-            LIBTUNERERR << "line " << lineno << ": Warning: skipped identifier without value" << endl;
-            continue;
+            size_t len = strlen(environ[i]);
+            memcpy(pos, environ[i], len + 1);
+            char *sep = strchr(pos, '=');
+            if ((sep != NULL) && (sep != pos))
+            {
+               *sep = '\0';
+               insert(pos, sep + 1);
+            }
+            pos += len + 1;
+         }
+      }
+
+      const tuner_config_value *find(const char *name, uint32_t hash) const
+      {
+         size_t mask = m_table.size() - 1;
+         for (size_t i = (hash & mask); m_table[i].name != NULL; i = ((i + 1) & mask))
+         {
+            if ((m_table[i].hash == hash) && (strcmp(m_table[i].name, name) == 0))
+            {
+               return &m_table[i].value;
+            }
+         }
+         return NULL;
+      }
+
+   private:
+
+      void insert(const char *name, const char *value)
+      {
+         uint32_t hash = hash_name(name);
+         size_t mask = m_table.size() - 1;
+         size_t i = (hash & mask);
+         // getenv() returns the first match, so keep the first duplicate.
+         for (; m_table[i].name != NULL; i = ((i + 1) & mask))
+         {
+            if ((m_table[i].hash == hash) && (strcmp(m_table[i].name, name) == 0))
+            {
+               return;
+            }
          }
-         token_end = line.find_last_not_of(WHITESPACE) + 1;
-         string value = line.substr(token_begin, token_end);
-         set_string(ident, value);
+         m_table[i].hash = hash;
+         m_table[i].name = name;
+         parse_value(m_table[i].value, value);
       }
+
+      std::vector<char> m_block;
+
+      std::vector<env_entry> m_table;
+};
+
+static env_snapshot *snapshot_environment(void)
+{
+   try
+   {
+      return new env_snapshot();
    }
    catch(...)
    {
-      error = ENOMEM;
+      return NULL;
    }
-   return error;
 }
-               
-int tuner_config::load_file(const char *filename)
+
+static env_snapshot *env_current = NULL;
+
+
+struct key_name
 {
-   ifstream file(filename);
-   if (!file.is_open())
-   {
-      return ENOENT;
-   }
-   int error = load(file);
-   file.close();
-   return error;
-}
+   const char *key;
+   uint32_t len;
+   uint32_t hash;
+   size_t id;
+};
 
-int tuner_config::load_string(const char *str)
+struct key_names
 {
-   return load_string(str, '\n');
+   size_t mask;
+   key_name *slots;
+};
+
+/*
+ * Interned keys, lowercased.  The hash table is read without a lock and
+ * replaced by a larger copy as it fills; the list by id is only used by
+ * writers.  Both only change with config_write_lock held, and are never
+ * freed.
+ */
+static key_names *key_registry = NULL;
+static vector<key_name> *interned_keys = NULL;
+
+// The name of a compiled file's i'th key.
+static const char *compiled_name(const char *key_table, const char *pool, size_t i)
+{
+   tuner_config_compiled_key key;
+   memcpy(&key, key_table + (i * sizeof(key)), sizeof(key));
+   return (pool + key.key_offset);
 }
 
-int tuner_config::load_string(const char *str, char line_delim)
+// Compares a NUL-terminated name with a key of len bytes, as strcmp() would.
+static int compare_name(const char *name, const char *key, size_t len)
 {
-   string s(str);
-   istringstream strstream(s);
-   return load(strstream, line_delim);
+   int result = strncmp(name, key, len);
+   if (result == 0)
+   {
+      result = ((name[len] == '\0') ? 0 : 1);
+   }
+   return result;
 }
 
-int tuner_config::set_string(const char *key, const char *value)
+// Returns the index of a lowercased key in a layer, or its count if absent.
+template <typename block_type>
+static size_t find_compiled(const block_type *layer, const char *key, size_t len)
 {
-   int error = 0;
-   try
+   size_t low = 0;
+   size_t high = layer->count;
+   while (low < high)
    {
-      string keystr(key), valstr(value);
-      set_string(keystr, valstr);
+      size_t mid = low + ((high - low) / 2);
+      int result = compare_name(compiled_name(layer->key_table, layer->pool, mid), key, len);
+      if (result == 0)
+      {
+         return mid;
+      }
+      else if (result < 0)
+      {
+         low = mid + 1;
+      }
+      else
+      {
+         high = mid;
+      }
    }
-   catch(...)
+   return layer->count;
+}
+
+// Every config, so a newly interned key gets an index entry in each.
+static tuner_config *all_configs = NULL;
+
+static size_t find_key(const char *key, size_t len, uint32_t hash)
+{
+   key_names *names = __atomic_load_n(&key_registry, __ATOMIC_ACQUIRE);
+   if (names == NULL)
    {
-      error = ENOMEM;
+      return tuner_config_key::invalid_id;
    }
-   return error;
+   key_name *slot = probe(names->slots, names->mask, key, len, hash);
+   return ((__atomic_load_n(&slot->key, __ATOMIC_ACQUIRE) == NULL) ? tuner_config_key::invalid_id : slot->id);
 }
 
-void tuner_config::set_string(string &key, string &value)
+static size_t interned_count(void)
 {
-   transform(key.begin(), key.end(), key.begin(), (int(*)(int))std::tolower);
-   m_map.erase(key);
-   m_map.insert(pair<string, string> (key, value));
+   return ((interned_keys == NULL) ? 0 : interned_keys->size());
 }
 
-const char *tuner_config::get_string(const char *key)
+tuner_config_key::tuner_config_key(const char *name)
+   : m_name(name),
+     m_id(tuner_config::intern(name)),
+     m_hash(hash(name))
+{
+}
+
+uint32_t tuner_config_key::hash(const char *name)
+{
+   return hash_name(name);
+}
+
+// Serializes all changes to configs and to the links between them.
+static pthread_mutex_t config_write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct config_notification
+{
+   tuner_config_listener *listener;
+   tuner_config *config;
+   list<string> keys;
+};
+
+typedef list<config_notification> notify_list;
+
+// Notifications not yet delivered, protected by config_write_lock.
+static notify_list &pending_notifications(void)
 {
-   const char *str = getenv(key);
-   if (str == NULL)
-   {  
-      str = get_config_string(key);
+   static notify_list pending;
+   return pending;
+}
+
+/*
+ * Listeners are called in order, one at a time, after the write lock has
+ * been dropped.  A thread that changes the config from inside a listener
+ * leaves its notifications to the dispatch loop it is already running in.
+ */
+static pthread_mutex_t notify_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t notify_thread;
+static bool notifying = false;
+
+static bool in_listener(void)
+{
+   return (notifying && pthread_equal(notify_thread, pthread_self()));
+}
+
+static void dispatch_notifications(void)
+{
+   pthread_mutex_lock(&config_write_lock);
+   bool nested = in_listener();
+   pthread_mutex_unlock(&config_write_lock);
+   if (nested)
+   {
+      return;
+   }
+   pthread_mutex_lock(&notify_lock);
+   pthread_mutex_lock(&config_write_lock);
+   notify_thread = pthread_self();
+   notifying = true;
+   for (;;)
+   {
+      notify_list &pending = pending_notifications();
+      if (pending.empty())
+      {
+         break;
+      }
+      notify_list current;
+      current.splice(current.begin(), pending, pending.begin());
+      pthread_mutex_unlock(&config_write_lock);
+      current.front().listener->config_changed(*current.front().config, current.front().keys);
+      pthread_mutex_lock(&config_write_lock);
    }
-   return str;
+   notifying = false;
+   pthread_mutex_unlock(&config_write_lock);
+   pthread_mutex_unlock(&notify_lock);
 }
 
-const char *tuner_config::get_config_string(const char *key)
+// Waits until no listener is being called, unless called from one.
+static void wait_for_listeners(void)
 {
-   const char *str = NULL;
-   if (m_next != NULL)
+   pthread_mutex_lock(&config_write_lock);
+   bool nested = in_listener();
+   pthread_mutex_unlock(&config_write_lock);
+   if (!nested)
    {
-      str = m_next->get_string(key);
+      pthread_mutex_lock(&notify_lock);
+      pthread_mutex_unlock(&notify_lock);
    }
-   if (str == NULL)
+}
+
+// Drops notifications matching the given listener or config; write lock held.
+static void cancel_notifications(const tuner_config_listener *listener, const tuner_config *config)
+{
+   notify_list &pending = pending_notifications();
+   notify_list::iterator it = pending.begin();
+   while (it != pending.end())
    {
-      try
+      if ((it->listener == listener) || (it->config == config))
       {
-         string strkey(key);
-         transform(strkey.begin(), strkey.end(), strkey.begin(), (int(*)(int))std::tolower);
-         strmap::iterator it = m_map.find(strkey);
-         if (it != m_map.end())
-         {
-            return it->second.c_str();
-         }
-         return NULL;
+         it = pending.erase(it);
       }
-      catch(...)
+      else
       {
-         return NULL;
+         ++it;
       }
    }
-   return str;
 }
 
-int tuner_config::add_config(tuner_config &config)
+
+/*
+ * Storage for values: the text of one load, one compiled file or one
+ * set_string() value.  live counts the table slots and file records that
+ * refer to it, plus one held by the update creating it; once none do, the
+ * block is retired.
+ *
+ * A compiled file is not copied into the table but kept as a layer, its
+ * values searched in the file's own sorted key table, and referred to by
+ * m_layers until every one of its keys is defined by a newer layer.
+ */
+struct tuner_config::value_block
+{
+   void *data;
+   size_t size;
+   bool mapped;
+   tuner_config_value *values;
+   size_t count;
+   size_t live;
+   size_t retired_at;
+   value_block *prev;
+   value_block *next;
+   const char *key_table;
+   const char *pool;
+   // Keys defined by a newer layer, one bit each.
+   unsigned char *shadowed;
+   size_t shadowed_count;
+   value_block *layer_next;
+};
+
+struct tuner_config::value_slot
+{
+   const char *key;
+   uint32_t len;
+   uint32_t hash;
+   const tuner_config_value *value;
+   value_block *block;
+};
+
+/*
+ * A config's own values, by lowercased key.  Keys are never removed, only
+ * given a NULL value, so a key keeps its slot and its stored name for the
+ * life of the config.
+ */
+struct tuner_config::value_table
 {
-   if (&config == this)
+   explicit value_table(size_t capacity)
+      : mask(capacity - 1),
+        used(0),
+        slots(new value_slot[capacity]())
+   {}
+
+   ~value_table(void)
    {
-      return EINVAL;  
+      delete[] slots;
    }
-   if (m_next != NULL)
+
+   size_t mask;
+   size_t used;
+   value_slot *slots;
+};
+
+/*
+ * The value visible through a config for each interned key, NULL where it
+ * has none.  Entries below size are valid; a new entry is filled before
+ * size is raised past it.
+ */
+struct tuner_config::key_index
+{
+   explicit key_index(size_t cap)
+      : size(0),
+        capacity(cap),
+        slots(new const tuner_config_value*[cap])
+   {}
+
+   ~key_index(void)
    {
-      return m_next->add_config(config);
+      delete[] slots;
    }
-   m_next = &config;
-   return 0;
-}
 
-void tuner_config::remove_config(tuner_config &config)     
+   size_t size;
+   size_t capacity;
+   const tuner_config_value **slots;
+};
+
+// id is one more than the key's interned id, so that 0 marks an empty slot.
+struct tuner_config::override_slot
 {
-   if (m_next != NULL)
+   size_t id;
+   const tuner_config_value *value;
+};
+
+/*
+ * A scope's index: only the interned keys it overrides, through its own
+ * chain or under its prefix in the parent, kept at most half full.  Keys
+ * are never removed, only given a NULL value.  Keys with ids from size on
+ * have not been looked at yet.
+ */
+struct tuner_config::override_index
+{
+   explicit override_index(size_t capacity)
+      : mask(capacity - 1),
+        used(0),
+        size(0),
+        slots(new override_slot[capacity]())
+   {}
+
+   ~override_index(void)
    {
-      if (m_next == &config)
+      delete[] slots;
+   }
+
+   size_t mask;
+   size_t used;
+   size_t size;
+   override_slot *slots;
+};
+
+template <typename slot_type>
+static slot_type *probe_id(slot_type *slots, size_t mask, size_t id)
+{
+   for (size_t i = (id & mask);; i = ((i + 1) & mask))
+   {
+      size_t slot_id = __atomic_load_n(&slots[i].id, __ATOMIC_ACQUIRE);
+      if ((slot_id == 0) || (slot_id == (id + 1)))
       {
-         m_next = m_next->m_next;    
+         return &slots[i];
       }
-      else
+   }
+}
+
+// A key as seen by a config with listeners, before an update.
+struct tuner_config::change
+{
+   change(tuner_config *c, const string &k, const tuner_config_value *v)
+      : config(c),
+        key(k),
+        value(v)
+   {}
+
+   bool operator<(const change &other) const
+   {
+      return ((config != other.config) ? (config < other.config) : (key < other.key));
+   }
+
+   tuner_config *config;
+   string key;
+   const tuner_config_value *value;
+};
+
+/*
+ * What one update leaves to do once the write lock is dropped: tables
+ * replaced by larger copies and expired blocks, freed after a grace period,
+ * and the keys to compare for listeners.
+ */
+struct tuner_config::update
+{
+   update(void) : expired(NULL) {}
+
+   vector<value_table*> old_tables;
+   vector<key_index*> old_indexes;
+   vector<override_index*> old_overrides;
+   value_block *expired;
+   vector<change> changes;
+   // Configs whose every key was captured, since the update may add keys.
+   vector<tuner_config*> enumerated;
+};
+
+#define KEY_CHUNK_SIZE 16384
+
+tuner_config::tuner_config(void)
+   : m_table(NULL),
+     m_index(NULL),
+     m_overrides(NULL),
+     m_layers(NULL),
+     m_blocks(NULL),
+     m_retired(NULL),
+     m_retired_tail(NULL),
+     m_retired_count(0),
+     m_key_free(NULL),
+     m_key_avail(0),
+     m_next(NULL),
+     m_parent(NULL),
+     m_prefix_hash(FNV_BASIS),
+     m_all_prev(NULL),
+     m_all_next(NULL)
+{
+   update u;
+   begin_update();
+   link();
+   try
+   {
+      update_index(u, false);
+   }
+   catch(...)
+   {
+      // Lookups fall back to walking the chain.
+   }
+   end_update(u);
+}
+
+tuner_config::tuner_config(tuner_config &parent, const char *prefix, int &error)
+   : m_table(NULL),
+     m_index(NULL),
+     m_overrides(NULL),
+     m_layers(NULL),
+     m_blocks(NULL),
+     m_retired(NULL),
+     m_retired_tail(NULL),
+     m_retired_count(0),
+     m_key_free(NULL),
+     m_key_avail(0),
+     m_next(NULL),
+     m_parent(NULL),
+     m_prefix_hash(FNV_BASIS),
+     m_all_prev(NULL),
+     m_all_next(NULL)
+{
+   if (error)
+   {
+      return;
+   }
+   update u;
+   begin_update();
+   link();
+   try
+   {
+      m_prefix = prefix;
+      transform(m_prefix.begin(), m_prefix.end(), m_prefix.begin(), (int(*)(int))std::tolower);
+      m_prefix_hash = hash_bytes(FNV_BASIS, m_prefix.data(), m_prefix.size());
+      parent.m_scopes.push_back(this);
+      __atomic_store_n(&m_parent, &parent, __ATOMIC_RELEASE);
+      m_overrides = new override_index(16);
+      update_index(u, false);
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+   }
+   end_update(u);
+}
+
+tuner_config::~tuner_config(void)
+{
+   // Unlink from every chain this config is still part of.
+   update u;
+   begin_update();
+   cancel_notifications(NULL, this);
+   try
+   {
+      for (list<tuner_config*>::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+      {
+         (*it)->capture_all(u);
+      }
+      for (list<tuner_config*>::iterator it = m_referrers.begin(); it != m_referrers.end(); ++it)
+      {
+         (*it)->capture_all(u);
+      }
+   }
+   catch(...)
+   {
+      LIBTUNERERR << "Unable to queue configuration change notification" << endl;
+   }
+   if (m_next != NULL)
+   {
+      m_next->m_referrers.remove(this);
+   }
+   if (m_parent != NULL)
+   {
+      m_parent->m_scopes.remove(this);
+   }
+   for (list<tuner_config*>::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+   {
+      __atomic_store_n(&(*it)->m_parent, (tuner_config*)NULL, __ATOMIC_RELEASE);
+   }
+   for (list<tuner_config*>::iterator it = m_referrers.begin(); it != m_referrers.end(); ++it)
+   {
+      __atomic_store_n(&(*it)->m_next, m_next, __ATOMIC_RELEASE);
+      if (m_next != NULL)
+      {
+         try
+         {
+            m_next->m_referrers.push_back(*it);
+         }
+         catch(...)
+         {
+            LIBTUNERERR << "Unable to relink configuration chain" << endl;
+         }
+      }
+   }
+   try
+   {
+      for (list<tuner_config*>::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+      {
+         (*it)->refresh_all(u);
+      }
+      for (list<tuner_config*>::iterator it = m_referrers.begin(); it != m_referrers.end(); ++it)
+      {
+         (*it)->refresh_all(u);
+      }
+   }
+   catch(...)
+   {
+      LIBTUNERERR << "Unable to rebuild configuration index" << endl;
+   }
+   unlink();
+   end_update(u);
+   wait_for_listeners();
+   // Readers may have been walking through this config until it was unlinked.
+   rcu_synchronize();
+   delete m_table;
+   delete m_index;
+   delete m_overrides;
+   while (m_blocks != NULL)
+   {
+      value_block *next = m_blocks->next;
+      free_block(m_blocks);
+      m_blocks = next;
+   }
+   while (m_retired != NULL)
+   {
+      value_block *next = m_retired->next;
+      free_block(m_retired);
+      m_retired = next;
+   }
+   for (size_t i = 0; i < m_key_chunks.size(); ++i)
+   {
+      delete[] m_key_chunks[i];
+   }
+}
+
+void tuner_config::link(void)
+{
+   m_all_next = all_configs;
+   if (all_configs != NULL)
+   {
+      all_configs->m_all_prev = this;
+   }
+   all_configs = this;
+}
+
+void tuner_config::unlink(void)
+{
+   if (m_all_prev != NULL)
+   {
+      m_all_prev->m_all_next = m_all_next;
+   }
+   else if (all_configs == this)
+   {
+      all_configs = m_all_next;
+   }
+   if (m_all_next != NULL)
+   {
+      m_all_next->m_all_prev = m_all_prev;
+   }
+}
+
+void tuner_config::begin_update(void)
+{
+   pthread_mutex_lock(&config_write_lock);
+}
+
+/*
+ * Queues notifications and drops the write lock, then frees whatever the
+ * update replaced once no reader can still be using it.
+ */
+void tuner_config::end_update(update &u)
+{
+   queue_notifications(u);
+   pthread_mutex_unlock(&config_write_lock);
+   if (!u.old_tables.empty() || !u.old_indexes.empty() || !u.old_overrides.empty() || (u.expired != NULL))
+   {
+      rcu_synchronize();
+      for (size_t i = 0; i < u.old_tables.size(); ++i)
+      {
+         delete u.old_tables[i];
+      }
+      for (size_t i = 0; i < u.old_indexes.size(); ++i)
+      {
+         delete u.old_indexes[i];
+      }
+      for (size_t i = 0; i < u.old_overrides.size(); ++i)
+      {
+         delete u.old_overrides[i];
+      }
+      while (u.expired != NULL)
+      {
+         value_block *next = u.expired->next;
+         free_block(u.expired);
+         u.expired = next;
+      }
+   }
+   dispatch_notifications();
+}
+
+size_t tuner_config::intern(const char *name)
+{
+   size_t len = strlen(name);
+   char *key = new(nothrow) char[len + 1];
+   if (key == NULL)
+   {
+      return tuner_config_key::invalid_id;
+   }
+   uint32_t hash = lower_key(key, name, len);
+   key[len] = '\0';
+   update u;
+   key_names *old_names = NULL;
+   begin_update();
+   size_t id = find_key(key, len, hash);
+   if (id == tuner_config_key::invalid_id)
+   {
+      try
+      {
+         if (interned_keys == NULL)
+         {
+            interned_keys = new vector<key_name>();
+         }
+         // Nothing below throws once the list has room for the key.
+         interned_keys->reserve(interned_keys->size() + 1);
+         key_names *names = key_registry;
+         if ((names == NULL) || (((interned_keys->size() + 1) * 2) > (names->mask + 1)))
+         {
+            size_t capacity = ((names == NULL) ? 64 : ((names->mask + 1) * 2));
+            key_names *grown = new key_names;
+            grown->mask = capacity - 1;
+            grown->slots = new(nothrow) key_name[capacity]();
+            if (grown->slots == NULL)
+            {
+               delete grown;
+               throw bad_alloc();
+            }
+            for (size_t i = 0; i < interned_keys->size(); ++i)
+            {
+               const key_name &interned = (*interned_keys)[i];
+               *probe(grown->slots, grown->mask, interned.key, interned.len, interned.hash) = interned;
+            }
+            old_names = names;
+            __atomic_store_n(&key_registry, grown, __ATOMIC_RELEASE);
+            names = grown;
+         }
+         key_name entry = {key, (uint32_t)len, hash, interned_keys->size()};
+         interned_keys->push_back(entry);
+         key_name *slot = probe(names->slots, names->mask, key, len, hash);
+         slot->len = entry.len;
+         slot->hash = entry.hash;
+         slot->id = entry.id;
+         __atomic_store_n(&slot->key, entry.key, __ATOMIC_RELEASE);
+         id = entry.id;
+         key = NULL;
+         for (tuner_config *config = all_configs; config != NULL; config = config->m_all_next)
+         {
+            config->update_index(u, false);
+         }
+      }
+      catch(...)
+      {
+         // A config without an entry for the key walks its chain instead.
+      }
+   }
+   end_update(u);
+   if (old_names != NULL)
+   {
+      rcu_synchronize();
+      delete[] old_names->slots;
+      delete old_names;
+   }
+   delete[] key;
+   return id;
+}
+
+/*
+ * Moves a block no longer referred to onto the retired list, and hands
+ * back, in batches, blocks retired at least TUNER_CONFIG_RETIRED_VALUES
+ * values ago.
+ */
+void tuner_config::release(update &u, value_block *block)
+{
+   if ((block == NULL) || (--block->live > 0))
+   {
+      return;
+   }
+   if (block->prev != NULL)
+   {
+      block->prev->next = block->next;
+   }
+   else
+   {
+      m_blocks = block->next;
+   }
+   if (block->next != NULL)
+   {
+      block->next->prev = block->prev;
+   }
+   block->prev = block->next = NULL;
+   m_retired_count += block->count;
+   block->retired_at = m_retired_count;
+   if (m_retired_tail != NULL)
+   {
+      m_retired_tail->next = block;
+   }
+   else
+   {
+      m_retired = block;
+   }
+   m_retired_tail = block;
+   if ((m_retired_count - m_retired->retired_at) < (2 * TUNER_CONFIG_RETIRED_VALUES))
+   {
+      return;
+   }
+   while ((m_retired != NULL) && ((m_retired_count - m_retired->retired_at) >= TUNER_CONFIG_RETIRED_VALUES))
+   {
+      value_block *expired = m_retired;
+      m_retired = expired->next;
+      expired->next = u.expired;
+      u.expired = expired;
+   }
+   if (m_retired == NULL)
+   {
+      m_retired_tail = NULL;
+   }
+}
+
+void tuner_config::adopt(value_block *block)
+{
+   block->prev = NULL;
+   block->next = m_blocks;
+   if (m_blocks != NULL)
+   {
+      m_blocks->prev = block;
+   }
+   m_blocks = block;
+}
+
+/*
+ * Puts a compiled file in front of the others.  Values set before it for
+ * keys it defines are removed, so that it takes precedence over them as
+ * it would over older files, and older files whose every key it or other
+ * newer files define are retired.
+ */
+void tuner_config::add_layer(update &u, value_block *layer)
+{
+   if ((m_table != NULL) && (m_table->used > 0))
+   {
+      for (size_t i = 0; i < layer->count; ++i)
+      {
+         const char *name = compiled_name(layer->key_table, layer->pool, i);
+         size_t len = strlen(name);
+         value_slot *slot = find_slot(name, len, hash_bytes(FNV_BASIS, name, len));
+         if ((slot != NULL) && (slot->value != NULL))
+         {
+            set_slot(u, slot, NULL, NULL);
+         }
+      }
+   }
+   value_block **link = &m_layers;
+   while (*link != NULL)
+   {
+      value_block *older = *link;
+      size_t i = 0;
+      size_t j = 0;
+      while ((i < layer->count) && (j < older->count))
+      {
+         int result = strcmp(compiled_name(layer->key_table, layer->pool, i),
+                             compiled_name(older->key_table, older->pool, j));
+         if (result < 0)
+         {
+            ++i;
+         }
+         else if (result > 0)
+         {
+            ++j;
+         }
+         else
+         {
+            if (!(older->shadowed[j / 8] & (1 << (j % 8))))
+            {
+               older->shadowed[j / 8] |= (unsigned char)(1 << (j % 8));
+               ++older->shadowed_count;
+            }
+            ++i;
+            ++j;
+         }
+      }
+      if (older->shadowed_count == older->count)
+      {
+         // Readers already on it still find the rest of the list through it.
+         __atomic_store_n(link, older->layer_next, __ATOMIC_RELEASE);
+         release(u, older);
+      }
+      else
+      {
+         link = &older->layer_next;
+      }
+   }
+   ++layer->live;
+   layer->layer_next = m_layers;
+   __atomic_store_n(&m_layers, layer, __ATOMIC_RELEASE);
+}
+
+tuner_config::value_block *tuner_config::new_block(size_t size, size_t count)
+{
+   value_block *block = new(nothrow) value_block;
+   if (block == NULL)
+   {
+      return NULL;
+   }
+   memset(block, 0, sizeof(*block));
+   block->size = size;
+   block->count = count;
+   block->live = 1;
+   if (((size > 0) && ((block->data = new(nothrow) char[size]) == NULL)) ||
+       ((count > 0) && ((block->values = new(nothrow) tuner_config_value[count]) == NULL)))
+   {
+      free_block(block);
+      return NULL;
+   }
+   return block;
+}
+
+void tuner_config::free_block(value_block *block)
+{
+   if (block->mapped)
+   {
+      munmap(block->data, block->size);
+   }
+   else
+   {
+      delete[] static_cast<char*>(block->data);
+   }
+   delete[] block->values;
+   delete[] block->shadowed;
+   delete block;
+}
+
+// Makes room for count more keys, replacing the table if needed.
+void tuner_config::reserve(update &u, size_t count)
+{
+   value_table *table = m_table;
+   size_t needed = (((table == NULL) ? 0 : table->used) + count) * 2;
+   size_t capacity = ((table == NULL) ? 16 : (table->mask + 1));
+   if ((table != NULL) && (needed <= capacity))
+   {
+      return;
+   }
+   while (capacity < needed)
+   {
+      capacity *= 2;
+   }
+   value_table *grown = new value_table(capacity);
+   if (table != NULL)
+   {
+      try
+      {
+         u.old_tables.push_back(table);
+      }
+      catch(...)
+      {
+         delete grown;
+         throw;
+      }
+      for (size_t i = 0; i <= table->mask; ++i)
+      {
+         const value_slot &slot = table->slots[i];
+         if (slot.key != NULL)
+         {
+            *probe(grown->slots, grown->mask, slot.key, slot.len, slot.hash) = slot;
+         }
+      }
+      grown->used = table->used;
+   }
+   __atomic_store_n(&m_table, grown, __ATOMIC_RELEASE);
+}
+
+// Returns the slot for a lowercased key, adding it with no value if needed.
+tuner_config::value_slot *tuner_config::insert_key(update &u, const char *key, size_t len, uint32_t hash)
+{
+   reserve(u, 1);
+   value_slot *slot = probe(m_table->slots, m_table->mask, key, len, hash);
+   if (slot->key == NULL)
+   {
+      const char *stored = store_key(key, len);
+      slot->len = (uint32_t)len;
+      slot->hash = hash;
+      slot->value = NULL;
+      slot->block = NULL;
+      __atomic_store_n(&slot->key, stored, __ATOMIC_RELEASE);
+      ++m_table->used;
+   }
+   return slot;
+}
+
+tuner_config::value_slot *tuner_config::find_slot(const char *key, size_t len, uint32_t hash)
+{
+   if (m_table == NULL)
+   {
+      return NULL;
+   }
+   value_slot *slot = probe(m_table->slots, m_table->mask, key, len, hash);
+   return ((slot->key == NULL) ? NULL : slot);
+}
+
+const char *tuner_config::store_key(const char *key, size_t len)
+{
+   if ((len + 1) > m_key_avail)
+   {
+      size_t size = (((len + 1) > KEY_CHUNK_SIZE) ? (len + 1) : KEY_CHUNK_SIZE);
+      char *chunk = new char[size];
+      try
+      {
+         m_key_chunks.push_back(chunk);
+      }
+      catch(...)
+      {
+         delete[] chunk;
+         throw;
+      }
+      m_key_free = chunk;
+      m_key_avail = size;
+   }
+   char *stored = m_key_free;
+   memcpy(stored, key, len);
+   stored[len] = '\0';
+   m_key_free += (len + 1);
+   m_key_avail -= (len + 1);
+   return stored;
+}
+
+void tuner_config::set_slot(update &u, value_slot *slot, const tuner_config_value *value, value_block *block)
+{
+   value_block *old = slot->block;
+   if (block != NULL)
+   {
+      ++block->live;
+   }
+   __atomic_store_n(&slot->value, value, __ATOMIC_RELEASE);
+   slot->block = block;
+   release(u, old);
+}
+
+/*
+ * Fills index entries for keys interned since the index was last updated,
+ * or with all set, recomputes every entry.
+ */
+void tuner_config::update_index(update &u, bool all)
+{
+   size_t count = interned_count();
+   if (m_overrides != NULL)
+   {
+      try
+      {
+         for (size_t id = (all ? 0 : m_overrides->size); id < count; ++id)
+         {
+            const key_name &name = (*interned_keys)[id];
+            set_override(u, id, resolve(name.key, name.len, name.hash, false));
+         }
+      }
+      catch(...)
+      {
+         __atomic_store_n(&m_overrides->size, 0, __ATOMIC_RELEASE);
+         throw;
+      }
+      if (count > m_overrides->size)
+      {
+         __atomic_store_n(&m_overrides->size, count, __ATOMIC_RELEASE);
+      }
+      return;
+   }
+   key_index *index = m_index;
+   if ((index == NULL) || (index->capacity < count))
+   {
+      size_t capacity = ((index == NULL) ? 16 : (index->capacity * 2));
+      while (capacity < count)
+      {
+         capacity *= 2;
+      }
+      key_index *grown = new key_index(capacity);
+      if (index != NULL)
+      {
+         try
+         {
+            u.old_indexes.push_back(index);
+         }
+         catch(...)
+         {
+            delete grown;
+            throw;
+         }
+         memcpy(grown->slots, index->slots, index->size * sizeof(grown->slots[0]));
+         grown->size = index->size;
+      }
+      __atomic_store_n(&m_index, grown, __ATOMIC_RELEASE);
+      index = grown;
+   }
+   for (size_t id = (all ? 0 : index->size); id < count; ++id)
+   {
+      const key_name &name = (*interned_keys)[id];
+      __atomic_store_n(&index->slots[id], resolve(name.key, name.len, name.hash, true), __ATOMIC_RELEASE);
+   }
+   if (count > index->size)
+   {
+      __atomic_store_n(&index->size, count, __ATOMIC_RELEASE);
+   }
+}
+
+// Sets a scope's entry for an interned key, adding it only if overridden.
+void tuner_config::set_override(update &u, size_t id, const tuner_config_value *value)
+{
+   override_index *index = m_overrides;
+   override_slot *slot = probe_id(index->slots, index->mask, id);
+   if (slot->id != 0)
+   {
+      __atomic_store_n(&slot->value, value, __ATOMIC_RELEASE);
+      return;
+   }
+   if (value == NULL)
+   {
+      return;
+   }
+   if (((index->used + 1) * 2) > (index->mask + 1))
+   {
+      override_index *grown = new override_index((index->mask + 1) * 2);
+      try
+      {
+         u.old_overrides.push_back(index);
+      }
+      catch(...)
+      {
+         delete grown;
+         throw;
+      }
+      for (size_t i = 0; i <= index->mask; ++i)
+      {
+         if (index->slots[i].id != 0)
+         {
+            *probe_id(grown->slots, grown->mask, index->slots[i].id - 1) = index->slots[i];
+         }
+      }
+      grown->used = index->used;
+      grown->size = index->size;
+      __atomic_store_n(&m_overrides, grown, __ATOMIC_RELEASE);
+      index = grown;
+      slot = probe_id(index->slots, index->mask, id);
+   }
+   slot->value = value;
+   __atomic_store_n(&slot->id, id + 1, __ATOMIC_RELEASE);
+   ++index->used;
+}
+
+/*
+ * Called for a lowercased key whose own value in this config is about to
+ * change or has changed.  Visits this config and every config that sees
+ * it, through a chain or as a scope, with the key as each of them sees it.
+ * With capture set, records what those with listeners see now; otherwise
+ * updates their index entries for the key.
+ */
+void tuner_config::propagate(update &u, const char *key, size_t len, uint32_t hash, bool capture)
+{
+   if (capture)
+   {
+      if (!m_listeners.empty())
+      {
+         u.changes.push_back(change(this, string(key, len), resolve(key, len, hash, true)));
+      }
+   }
+   else
+   {
+      size_t id = find_key(key, len, hash);
+      if ((id != tuner_config_key::invalid_id) && (m_overrides != NULL) && (id < m_overrides->size))
+      {
+         try
+         {
+            set_override(u, id, resolve(key, len, hash, false));
+         }
+         catch(...)
+         {
+            // Lookups in this scope fall back to walking the chain.
+            __atomic_store_n(&m_overrides->size, 0, __ATOMIC_RELEASE);
+         }
+      }
+      else if ((id != tuner_config_key::invalid_id) && (m_index != NULL) && (id < m_index->size))
+      {
+         __atomic_store_n(&m_index->slots[id], resolve(key, len, hash, true), __ATOMIC_RELEASE);
+      }
+   }
+   for (list<tuner_config*>::iterator it = m_referrers.begin(); it != m_referrers.end(); ++it)
+   {
+      (*it)->propagate(u, key, len, hash, capture);
+   }
+   for (list<tuner_config*>::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+   {
+      tuner_config *scope = *it;
+      size_t prefix_len = scope->m_prefix.size();
+      scope->propagate(u, key, len, hash, capture);
+      if ((len > prefix_len) && (memcmp(key, scope->m_prefix.data(), prefix_len) == 0))
+      {
+         const char *scoped = key + prefix_len;
+         scope->propagate(u, scoped, len - prefix_len, hash_bytes(FNV_BASIS, scoped, len - prefix_len), capture);
+      }
+   }
+}
+
+// Recomputes the index of this config and of every config that sees it.
+void tuner_config::refresh_all(update &u)
+{
+   update_index(u, true);
+   for (list<tuner_config*>::iterator it = m_referrers.begin(); it != m_referrers.end(); ++it)
+   {
+      (*it)->refresh_all(u);
+   }
+   for (list<tuner_config*>::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+   {
+      (*it)->refresh_all(u);
+   }
+}
+
+// Records every key seen by this config and those that see it, if listened to.
+void tuner_config::capture_all(update &u)
+{
+   if (!m_listeners.empty())
+   {
+      set<string> names;
+      enumerate(names);
+      for (set<string>::const_iterator it = names.begin(); it != names.end(); ++it)
+      {
+         u.changes.push_back(change(this, *it, resolve(it->data(), it->size(), hash_bytes(FNV_BASIS, it->data(), it->size()), true)));
+      }
+      u.enumerated.push_back(this);
+   }
+   for (list<tuner_config*>::iterator it = m_referrers.begin(); it != m_referrers.end(); ++it)
+   {
+      (*it)->capture_all(u);
+   }
+   for (list<tuner_config*>::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+   {
+      (*it)->capture_all(u);
+   }
+}
+
+bool tuner_config::has_listeners(void)
+{
+   if (!m_listeners.empty())
+   {
+      return true;
+   }
+   for (list<tuner_config*>::iterator it = m_referrers.begin(); it != m_referrers.end(); ++it)
+   {
+      if ((*it)->has_listeners())
+      {
+         return true;
+      }
+   }
+   for (list<tuner_config*>::iterator it = m_scopes.begin(); it != m_scopes.end(); ++it)
+   {
+      if ((*it)->has_listeners())
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+// Adds the name of every key visible through this config.
+void tuner_config::enumerate(set<string> &names)
+{
+   value_table *table = __atomic_load_n(&m_table, __ATOMIC_ACQUIRE);
+   if (table != NULL)
+   {
+      for (size_t i = 0; i <= table->mask; ++i)
+      {
+         const char *key = __atomic_load_n(&table->slots[i].key, __ATOMIC_ACQUIRE);
+         if ((key != NULL) && (__atomic_load_n(&table->slots[i].value, __ATOMIC_ACQUIRE) != NULL))
+         {
+            names.insert(string(key, table->slots[i].len));
+         }
+      }
+   }
+   for (value_block *layer = __atomic_load_n(&m_layers, __ATOMIC_ACQUIRE); layer != NULL;
+        layer = __atomic_load_n(&layer->layer_next, __ATOMIC_ACQUIRE))
+   {
+      for (size_t i = 0; i < layer->count; ++i)
+      {
+         names.insert(compiled_name(layer->key_table, layer->pool, i));
+      }
+   }
+   tuner_config *next = __atomic_load_n(&m_next, __ATOMIC_ACQUIRE);
+   if (next != NULL)
+   {
+      next->enumerate(names);
+   }
+   tuner_config *parent = __atomic_load_n(&m_parent, __ATOMIC_ACQUIRE);
+   if (parent != NULL)
+   {
+      set<string> parent_names;
+      parent->enumerate(parent_names);
+      for (set<string>::const_iterator it = parent_names.begin(); it != parent_names.end(); ++it)
+      {
+         names.insert(*it);
+         if ((it->size() > m_prefix.size()) && (it->compare(0, m_prefix.size(), m_prefix) == 0))
+         {
+            names.insert(it->substr(m_prefix.size()));
+         }
+      }
+   }
+}
+
+/*
+ * Compares what each listened-to config sees now with what was captured
+ * before the update, and queues a notification listing the keys that
+ * differ.  Called with the write lock held.
+ */
+void tuner_config::queue_notifications(update &u)
+{
+   try
+   {
+      for (size_t i = 0; i < u.enumerated.size(); ++i)
+      {
+         set<string> names;
+         u.enumerated[i]->enumerate(names);
+         for (set<string>::const_iterator it = names.begin(); it != names.end(); ++it)
+         {
+            // Only used where nothing was captured, as the stable sort keeps captures first.
+            u.changes.push_back(change(u.enumerated[i], *it, NULL));
+         }
+      }
+      stable_sort(u.changes.begin(), u.changes.end());
+      list<string> keys;
+      for (size_t i = 0; i < u.changes.size(); ++i)
+      {
+         const change &current = u.changes[i];
+         if ((i == 0) || (current < u.changes[i - 1]) || (u.changes[i - 1] < current))
+         {
+            const tuner_config_value *value = current.config->resolve(current.key.data(), current.key.size(),
+               hash_bytes(FNV_BASIS, current.key.data(), current.key.size()), true);
+            if ((value != current.value) &&
+                ((value == NULL) || (current.value == NULL) || (strcmp(value->str, current.value->str) != 0)))
+            {
+               keys.push_back(current.key);
+            }
+         }
+         if (((i + 1) == u.changes.size()) || (u.changes[i + 1].config != current.config))
+         {
+            if (!keys.empty())
+            {
+               for (list<tuner_config_listener*>::iterator it = current.config->m_listeners.begin();
+                    it != current.config->m_listeners.end(); ++it)
+               {
+                  notify_list notification(1);
+                  notification.front().listener = *it;
+                  notification.front().config = current.config;
+                  notification.front().keys = keys;
+                  pending_notifications().splice(pending_notifications().end(), notification);
+               }
+            }
+            keys.clear();
+         }
+      }
+   }
+   catch(...)
+   {
+      LIBTUNERERR << "Unable to queue configuration change notification" << endl;
+   }
+}
+
+void tuner_config::parse(const char *data, size_t size, char line_delim, vector<config_view> &entries)
+{
+   const char *end = data + size;
+   int lineno = 0;
+   for (const char *line = data; line < end; ++line)
+   {
+      const char *line_end = static_cast<const char*>(memchr(line, line_delim, (size_t)(end - line)));
+      if (line_end == NULL)
+      {
+         line_end = end;
+      }
+      ++lineno;
+      const char *pos = line;
+      line = line_end;
+      while ((pos < line_end) && is_whitespace(*pos))
+      {
+         ++pos;
+      }
+      if ((pos == line_end) || (*pos == '#'))
+      {
+         continue;
+      }
+      config_view entry;
+      entry.key = pos;
+      while ((pos < line_end) && !is_whitespace(*pos) && (*pos != '='))
+      {
+         ++pos;
+      }
+      entry.key_len = (size_t)(pos - entry.key);
+      while ((pos < line_end) && (is_whitespace(*pos) || (*pos == '=')))
+      {
+         ++pos;
+      }
+      const char *value_end = line_end;
+      while ((value_end > pos) && is_whitespace(*(value_end - 1)))
+      {
+         --value_end;
+      }
+      if (pos == value_end)
+      {
+         LIBTUNERERR << "line " << lineno << ": Warning: skipped identifier without value" << endl;
+         continue;
+      }
+      entry.value = pos;
+      entry.value_len = (size_t)(value_end - pos);
+      entries.push_back(entry);
+   }
+}
+
+
+int tuner_config::load(const char *data, size_t size, char line_delim, const char *filename)
+{
+   tuner_config *next_config = __atomic_load_n(&m_next, __ATOMIC_ACQUIRE);
+   if (next_config != NULL)
+   {
+      return next_config->load(data, size, line_delim, filename);
+   }
+   vector<config_view> entries;
+   try
+   {
+      parse(data, size, line_delim, entries);
+   }
+   catch(...)
+   {
+      return ENOMEM;
+   }
+   // All value strings go into one block.
+   size_t text_size = 0;
+   for (size_t i = 0; i < entries.size(); ++i)
+   {
+      text_size += entries[i].value_len + 1;
+   }
+   value_block *block = new_block(text_size, entries.size());
+   if (block == NULL)
+   {
+      return ENOMEM;
+   }
+   char *text = static_cast<char*>(block->data);
+   for (size_t i = 0; i < entries.size(); ++i)
+   {
+      memcpy(text, entries[i].value, entries[i].value_len);
+      text[entries[i].value_len] = '\0';
+      parse_value(block->values[i], text);
+      text += entries[i].value_len + 1;
+   }
+   update u;
+   begin_update();
+   adopt(block);
+   int error = 0;
+   try
+   {
+      string key;
+      if (has_listeners())
+      {
+         for (size_t i = 0; i < entries.size(); ++i)
+         {
+            key.resize(entries[i].key_len);
+            uint32_t hash = lower_key(&key[0], entries[i].key, entries[i].key_len);
+            propagate(u, key.data(), key.size(), hash, true);
+         }
+      }
+      // Reserved up front, so the slots stay where they are until the end.
+      vector<value_slot*> slots(entries.size());
+      reserve(u, entries.size());
+      for (size_t i = 0; i < entries.size(); ++i)
+      {
+         key.resize(entries[i].key_len);
+         uint32_t hash = lower_key(&key[0], entries[i].key, entries[i].key_len);
+         slots[i] = insert_key(u, key.data(), key.size(), hash);
+         set_slot(u, slots[i], &block->values[i], block);
+      }
+      if (entries.size() > interned_count())
+      {
+         refresh_all(u);
+      }
+      else
+      {
+         for (size_t i = 0; i < entries.size(); ++i)
+         {
+            propagate(u, slots[i]->key, slots[i]->len, slots[i]->hash, false);
+         }
+      }
+      if (filename != NULL)
+      {
+         // Where a key appears more than once, only the last value is kept.
+         file_record values;
+         values.reserve(entries.size());
+         for (size_t i = 0; i < entries.size(); ++i)
+         {
+            if (slots[i]->value == &block->values[i])
+            {
+               file_value value = {slots[i]->key, slots[i]->len, slots[i]->hash, &block->values[i], block};
+               values.push_back(value);
+            }
+         }
+         file_record &record = m_files[filename];
+         block->live += values.size();
+         for (size_t i = 0; i < record.size(); ++i)
+         {
+            release(u, record[i].block);
+         }
+         record.swap(values);
+      }
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+      try
+      {
+         refresh_all(u);
+      }
+      catch(...)
+      {
+         LIBTUNERERR << "Unable to rebuild configuration index" << endl;
+      }
+   }
+   release(u, block);
+   end_update(u);
+   return error;
+}
+
+int tuner_config::reload_file(const char *filename)
+{
+   int error = 0;
+   config_file file(filename, false, error);
+   if (error)
+   {
+      return error;
+   }
+   vector<config_view> entries;
+   try
+   {
+      parse(file.data(), file.size(), '\n', entries);
+   }
+   catch(...)
+   {
+      return ENOMEM;
+   }
+   update u;
+   begin_update();
+   tuner_config *owner = this;
+   map<string, file_record>::iterator record;
+   while ((owner != NULL) && ((record = owner->m_files.find(filename)) == owner->m_files.end()))
+   {
+      owner = owner->m_next;
+   }
+   if (owner == NULL)
+   {
+      error = ENOENT;
+   }
+   else
+   {
+      try
+      {
+         error = owner->reload(u, record->second, entries);
+      }
+      catch(...)
+      {
+         error = ENOMEM;
+         try
+         {
+            owner->refresh_all(u);
+         }
+         catch(...)
+         {
+            LIBTUNERERR << "Unable to rebuild configuration index" << endl;
+         }
+      }
+   }
+   end_update(u);
+   return error;
+}
+
+/*
+ * Orders a file's values by the address of their stored keys, which are
+ * unique within a config.
+ */
+struct record_order
+{
+   template <typename record_type>
+   bool operator()(const record_type &a, const record_type &b) const
+   {
+      return less<const char*>()(a.key, b.key);
+   }
+
+   template <typename record_type>
+   bool operator()(const record_type &a, const char *key) const
+   {
+      return less<const char*>()(a.key, key);
+   }
+};
+
+/*
+ * Applies the differences between a file's previous contents, recorded in
+ * old_values, and its new entries.  Only keys whose value still comes from
+ * the file are changed or removed.
+ */
+int tuner_config::reload(update &u, file_record &old_values, const vector<config_view> &entries)
+{
+   string key;
+   if (has_listeners())
+   {
+      for (size_t i = 0; i < entries.size(); ++i)
+      {
+         key.resize(entries[i].key_len);
+         uint32_t hash = lower_key(&key[0], entries[i].key, entries[i].key_len);
+         propagate(u, key.data(), key.size(), hash, true);
+      }
+      for (size_t i = 0; i < old_values.size(); ++i)
+      {
+         propagate(u, old_values[i].key, old_values[i].len, old_values[i].hash, true);
+      }
+   }
+   // Each entry's slot, by position in the table, which does not grow past here.
+   vector<pair<size_t, size_t> > latest(entries.size());
+   reserve(u, entries.size());
+   for (size_t i = 0; i < entries.size(); ++i)
+   {
+      key.resize(entries[i].key_len);
+      uint32_t hash = lower_key(&key[0], entries[i].key, entries[i].key_len);
+      latest[i] = make_pair((size_t)(insert_key(u, key.data(), key.size(), hash) - m_table->slots), i);
+   }
+   sort(latest.begin(), latest.end());
+   sort(old_values.begin(), old_values.end(), record_order());
+   vector<bool> in_file(old_values.size(), false);
+   file_record values;
+   values.reserve(latest.size());
+   vector<value_slot*> changed;
+   for (size_t j = 0; j < latest.size(); ++j)
+   {
+      // Where a key appears more than once, only the last value is used.
+      if (((j + 1) < latest.size()) && (latest[j + 1].first == latest[j].first))
+      {
+         continue;
+      }
+      value_slot *slot = &m_table->slots[latest[j].first];
+      const config_view &entry = entries[latest[j].second];
+      file_value file_val = {slot->key, slot->len, slot->hash, NULL, NULL};
+      file_record::iterator old = lower_bound(old_values.begin(), old_values.end(), slot->key, record_order());
+      if ((old != old_values.end()) && (old->key == slot->key))
+      {
+         file_val = *old;
+         in_file[old - old_values.begin()] = true;
+      }
+      if (slot->value != file_val.value)
+      {
+         // Set since the file was loaded; that value takes precedence.
+         if (file_val.value != NULL)
+         {
+            values.push_back(file_val);
+         }
+      }
+      else if ((file_val.value != NULL) &&
+               (strlen(file_val.value->str) == entry.value_len) &&
+               (memcmp(file_val.value->str, entry.value, entry.value_len) == 0))
+      {
+         values.push_back(file_val);
+      }
+      else
+      {
+         value_block *block = new_block(entry.value_len + 1, 1);
+         if (block == NULL)
+         {
+            throw bad_alloc();
+         }
+         adopt(block);
+         memcpy(block->data, entry.value, entry.value_len);
+         static_cast<char*>(block->data)[entry.value_len] = '\0';
+         parse_value(block->values[0], static_cast<char*>(block->data));
+         set_slot(u, slot, &block->values[0], block);
+         release(u, block);
+         file_val.value = &block->values[0];
+         file_val.block = block;
+         values.push_back(file_val);
+         changed.push_back(slot);
+      }
+   }
+   for (size_t i = 0; i < old_values.size(); ++i)
+   {
+      if (in_file[i])
+      {
+         continue;
+      }
+      value_slot *slot = find_slot(old_values[i].key, old_values[i].len, old_values[i].hash);
+      if ((slot != NULL) && (slot->value == old_values[i].value))
+      {
+         set_slot(u, slot, NULL, NULL);
+         changed.push_back(slot);
+      }
+   }
+   for (size_t i = 0; i < values.size(); ++i)
+   {
+      ++values[i].block->live;
+   }
+   for (size_t i = 0; i < old_values.size(); ++i)
+   {
+      release(u, old_values[i].block);
+   }
+   old_values.swap(values);
+   if (changed.size() > interned_count())
+   {
+      refresh_all(u);
+   }
+   else
+   {
+      for (size_t i = 0; i < changed.size(); ++i)
+      {
+         propagate(u, changed[i]->key, changed[i]->len, changed[i]->hash, false);
+      }
+   }
+   return 0;
+}
+
+int tuner_config::get_files(list<string> &files)
+{
+   int error = 0;
+   pthread_mutex_lock(&config_write_lock);
+   try
+   {
+      for (tuner_config *config = this; config != NULL; config = config->m_next)
+      {
+         for (map<string, file_record>::const_iterator it = config->m_files.begin(); it != config->m_files.end(); ++it)
+         {
+            files.push_back(it->first);
+         }
+      }
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+   }
+   pthread_mutex_unlock(&config_write_lock);
+   return error;
+}
+
+int tuner_config::add_listener(tuner_config_listener &listener)
+{
+   int error = 0;
+   pthread_mutex_lock(&config_write_lock);
+   try
+   {
+      m_listeners.push_back(&listener);
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+   }
+   pthread_mutex_unlock(&config_write_lock);
+   return error;
+}
+
+void tuner_config::remove_listener(tuner_config_listener &listener)
+{
+   pthread_mutex_lock(&config_write_lock);
+   m_listeners.remove(&listener);
+   cancel_notifications(&listener, NULL);
+   pthread_mutex_unlock(&config_write_lock);
+   wait_for_listeners();
+}
+
+int tuner_config::load_file(const char *filename)
+{
+   int error = 0;
+   config_file file(filename, true, error);
+   if (error)
+   {
+      return error;
+   }
+   return load(file.data(), file.size(), '\n', filename);
+}
+
+int tuner_config::save_compiled(const char *filename)
+{
+   tuner_config_compiled_header header;
+   vector<tuner_config_compiled_key> keys;
+   vector<char> pool;
+   unsigned int epoch = rcu_read_lock();
+   try
+   {
+      set<string> names;
+      enumerate(names);
+      keys.reserve(names.size());
+      for (set<string>::const_iterator it = names.begin(); it != names.end(); ++it)
+      {
+         const tuner_config_value *value = resolve(it->data(), it->size(), hash_bytes(FNV_BASIS, it->data(), it->size()), true);
+         if (value == NULL)
+         {
+            continue;
+         }
+         tuner_config_compiled_key key;
+         memset(&key, 0, sizeof(key));
+         key.key_offset = (uint32_t)pool.size();
+         pool.insert(pool.end(), it->c_str(), it->c_str() + it->size() + 1);
+         key.value_offset = (uint32_t)pool.size();
+         pool.insert(pool.end(), value->str, value->str + strlen(value->str) + 1);
+         key.numeric = (value->numeric ? 1 : 0);
+         key.integer = value->integer;
+         key.real = value->real;
+         keys.push_back(key);
+      }
+   }
+   catch(...)
+   {
+      rcu_read_unlock(epoch);
+      return ENOMEM;
+   }
+   rcu_read_unlock(epoch);
+   if (pool.size() > 0xFFFFFFFFU)
+   {
+      return EFBIG;
+   }
+   header.magic = TUNER_CONFIG_COMPILED_MAGIC;
+   header.version = TUNER_CONFIG_COMPILED_VERSION;
+   header.num_keys = (uint32_t)keys.size();
+   header.pool_size = (uint32_t)pool.size();
+   FILE *stream = fopen(filename, "w");
+   if (stream == NULL)
+   {
+      LIBTUNERERR << "Unable to open compiled config " << filename << ": " << strerror(errno) << endl;
+      return errno;
+   }
+   int error = 0;
+   if ((fwrite(&header, sizeof(header), 1, stream) != 1) ||
+       (!keys.empty() && (fwrite(&keys[0], sizeof(keys[0]), keys.size(), stream) != keys.size())) ||
+       (!pool.empty() && (fwrite(&pool[0], 1, pool.size(), stream) != pool.size())))
+   {
+      error = errno;
+   }
+   if ((fclose(stream) != 0) && !error)
+   {
+      error = errno;
+   }
+   return error;
+}
+
+int tuner_config::load_compiled(const char *filename)
+{
+   tuner_config *next_config = __atomic_load_n(&m_next, __ATOMIC_ACQUIRE);
+   if (next_config != NULL)
+   {
+      return next_config->load_compiled(filename);
+   }
+   int fd = open(filename, O_RDONLY);
+   if (fd < 0)
+   {
+      return errno;
+   }
+   struct stat st;
+   void *data = MAP_FAILED;
+   int error = 0;
+   if (fstat(fd, &st) < 0)
+   {
+      error = errno;
+   }
+   else if (st.st_size < (off_t)sizeof(tuner_config_compiled_header))
+   {
+      error = EINVAL;
+   }
+   else if ((data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+   {
+      error = errno;
+   }
+   close(fd);
+   if (error)
+   {
+      return error;
+   }
+   size_t size = (size_t)st.st_size;
+   const char *base = static_cast<const char*>(data);
+   tuner_config_compiled_header header;
+   memcpy(&header, base, sizeof(header));
+   const char *pool = base + sizeof(header) + ((size_t)header.num_keys * sizeof(tuner_config_compiled_key));
+   if ((header.magic != TUNER_CONFIG_COMPILED_MAGIC) ||
+       (header.version != TUNER_CONFIG_COMPILED_VERSION) ||
+       (((size - sizeof(header)) / sizeof(tuner_config_compiled_key)) < header.num_keys) ||
+       ((size_t)((base + size) - pool) < header.pool_size) ||
+       ((header.pool_size > 0) && (pool[header.pool_size - 1] != '\0')))
+   {
+      LIBTUNERERR << "Invalid compiled config " << filename << endl;
+      munmap(data, size);
+      return EINVAL;
+   }
+   const char *table = base + sizeof(header);
+   for (uint32_t i = 0; i < header.num_keys; ++i)
+   {
+      tuner_config_compiled_key key;
+      memcpy(&key, table + (i * sizeof(key)), sizeof(key));
+      // Lookups search the key table, so it must be strictly sorted.
+      if ((key.key_offset >= header.pool_size) || (key.value_offset >= header.pool_size) ||
+          ((i > 0) && (strcmp(compiled_name(table, pool, i - 1), pool + key.key_offset) >= 0)))
+      {
+         LIBTUNERERR << "Invalid compiled config " << filename << endl;
+         munmap(data, size);
+         return EINVAL;
+      }
+   }
+   value_block *block = new_block(0, header.num_keys);
+   if ((block != NULL) &&
+       ((block->shadowed = new(nothrow) unsigned char[(header.num_keys + 7) / 8]()) == NULL))
+   {
+      free_block(block);
+      block = NULL;
+   }
+   if (block == NULL)
+   {
+      munmap(data, size);
+      return ENOMEM;
+   }
+   block->data = data;
+   block->size = size;
+   block->mapped = true;
+   block->key_table = table;
+   block->pool = pool;
+   for (uint32_t i = 0; i < header.num_keys; ++i)
+   {
+      tuner_config_compiled_key key;
+      memcpy(&key, table + (i * sizeof(key)), sizeof(key));
+      block->values[i].str = pool + key.value_offset;
+      block->values[i].numeric = (key.numeric != 0);
+      block->values[i].integer = key.integer;
+      block->values[i].real = key.real;
+   }
+   update u;
+   begin_update();
+   adopt(block);
+   try
+   {
+      bool notify = has_listeners();
+      for (uint32_t i = 0; notify && (i < header.num_keys); ++i)
+      {
+         tuner_config_compiled_key key;
+         memcpy(&key, table + (i * sizeof(key)), sizeof(key));
+         const char *name = pool + key.key_offset;
+         size_t len = strlen(name);
+         propagate(u, name, len, hash_bytes(FNV_BASIS, name, len), true);
+      }
+      add_layer(u, block);
+      if (header.num_keys > interned_count())
+      {
+         refresh_all(u);
+      }
+      else
+      {
+         for (uint32_t i = 0; i < header.num_keys; ++i)
+         {
+            const char *name = compiled_name(table, pool, i);
+            size_t len = strlen(name);
+            propagate(u, name, len, hash_bytes(FNV_BASIS, name, len), false);
+         }
+      }
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+      try
+      {
+         refresh_all(u);
+      }
+      catch(...)
+      {
+         LIBTUNERERR << "Unable to rebuild configuration index" << endl;
+      }
+   }
+   release(u, block);
+   end_update(u);
+   return error;
+}
+
+int tuner_config::load_string(const char *str)
+{
+   return load_string(str, '\n');
+}
+
+int tuner_config::load_string(const char *str, char line_delim)
+{
+   return load(str, strlen(str), line_delim, NULL);
+}
+
+int tuner_config::set_string(const char *key, const char *value)
+{
+   size_t value_len = strlen(value);
+   value_block *block = new_block(value_len + 1, 1);
+   if (block == NULL)
+   {
+      return ENOMEM;
+   }
+   memcpy(block->data, value, value_len + 1);
+   parse_value(block->values[0], static_cast<char*>(block->data));
+   update u;
+   begin_update();
+   adopt(block);
+   int error = 0;
+   try
+   {
+      lowered_key lowered(key);
+      propagate(u, lowered.key(), lowered.len(), lowered.hash(), true);
+      set_slot(u, insert_key(u, lowered.key(), lowered.len(), lowered.hash()), &block->values[0], block);
+      propagate(u, lowered.key(), lowered.len(), lowered.hash(), false);
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+   }
+   release(u, block);
+   end_update(u);
+   return error;
+}
+
+int tuner_config::refresh_environment(void)
+{
+   env_snapshot *snapshot = snapshot_environment();
+   if (snapshot == NULL)
+   {
+      return ENOMEM;
+   }
+   env_snapshot *old = __atomic_exchange_n(&env_current, snapshot, __ATOMIC_ACQ_REL);
+   if (old != NULL)
+   {
+      rcu_synchronize();
+      delete old;
+   }
+   return 0;
+}
+
+const tuner_config_value *tuner_config::get_env_value(const char *name, uint32_t hash)
+{
+   env_snapshot *current = __atomic_load_n(&env_current, __ATOMIC_ACQUIRE);
+   if (current == NULL)
+   {
+      env_snapshot *snapshot = snapshot_environment();
+      if ((snapshot != NULL) &&
+          !__atomic_compare_exchange_n(&env_current, &current, snapshot, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      {
+         delete snapshot;
+      }
+      else
+      {
+         current = snapshot;
+      }
+   }
+   return ((current == NULL) ? NULL : current->find(name, hash));
+}
+
+bool tuner_config::get_value(const char *key, tuner_config_value &value)
+{
+   unsigned int epoch = rcu_read_lock();
+   const tuner_config_value *found = get_env_value(key, tuner_config_key::hash(key));
+   if (found == NULL)
+   {
+      found = get_config_value(key);
+   }
+   if (found != NULL)
+   {
+      value = *found;
+   }
+   rcu_read_unlock(epoch);
+   return (found != NULL);
+}
+
+const char *tuner_config::get_string(const char *key)
+{
+   tuner_config_value value;
+   return (get_value(key, value) ? value.str : NULL);
+}
+
+const tuner_config_value *tuner_config::get_config_value(const char *key)
+{
+   try
+   {
+      lowered_key lowered(key);
+      const tuner_config_value *value = NULL;
+      if (find_indexed(find_key(lowered.key(), lowered.len(), lowered.hash()), value))
+      {
+         return value;
+      }
+      return resolve(lowered.key(), lowered.len(), lowered.hash(), true);
+   }
+   catch(...)
+   {
+      return NULL;
+   }
+}
+
+bool tuner_config::get_value(const tuner_config_key &key, tuner_config_value &value)
+{
+   unsigned int epoch = rcu_read_lock();
+   const tuner_config_value *found = get_env_value(key.name(), key.m_hash);
+   if (found == NULL)
+   {
+      found = get_config_value(key);
+   }
+   if (found != NULL)
+   {
+      value = *found;
+   }
+   rcu_read_unlock(epoch);
+   return (found != NULL);
+}
+
+const char *tuner_config::get_string(const tuner_config_key &key)
+{
+   tuner_config_value value;
+   return (get_value(key, value) ? value.str : NULL);
+}
+
+const tuner_config_value *tuner_config::get_config_value(const tuner_config_key &key)
+{
+   const tuner_config_value *value = NULL;
+   if (find_indexed(key.id(), value))
+   {
+      return value;
+   }
+   return get_config_value(key.name());
+}
+
+// Looks an interned key up in the index, if it has an entry for it.
+bool tuner_config::find_indexed(size_t id, const tuner_config_value *&value)
+{
+   override_index *overrides = __atomic_load_n(&m_overrides, __ATOMIC_ACQUIRE);
+   if (overrides != NULL)
+   {
+      if ((id == tuner_config_key::invalid_id) || (id >= __atomic_load_n(&overrides->size, __ATOMIC_ACQUIRE)))
+      {
+         return false;
+      }
+      override_slot *slot = probe_id(overrides->slots, overrides->mask, id);
+      value = ((__atomic_load_n(&slot->id, __ATOMIC_ACQUIRE) == 0) ? NULL : __atomic_load_n(&slot->value, __ATOMIC_ACQUIRE));
+      tuner_config *parent = __atomic_load_n(&m_parent, __ATOMIC_ACQUIRE);
+      if ((value == NULL) && (parent != NULL))
+      {
+         return parent->find_indexed(id, value);
+      }
+      return true;
+   }
+   key_index *index = __atomic_load_n(&m_index, __ATOMIC_ACQUIRE);
+   if ((id == tuner_config_key::invalid_id) || (index == NULL) ||
+       (id >= __atomic_load_n(&index->size, __ATOMIC_ACQUIRE)))
+   {
+      return false;
+   }
+   value = __atomic_load_n(&index->slots[id], __ATOMIC_ACQUIRE);
+   return true;
+}
+
+// Looks a lowercased key up in this config's table, then its compiled files.
+const tuner_config_value *tuner_config::find_own(const char *key, size_t len, uint32_t hash)
+{
+   value_table *table = __atomic_load_n(&m_table, __ATOMIC_ACQUIRE);
+   if (table != NULL)
+   {
+      value_slot *slot = probe(table->slots, table->mask, key, len, hash);
+      if (__atomic_load_n(&slot->key, __ATOMIC_ACQUIRE) != NULL)
+      {
+         const tuner_config_value *value = __atomic_load_n(&slot->value, __ATOMIC_ACQUIRE);
+         if (value != NULL)
+         {
+            return value;
+         }
+      }
+   }
+   for (value_block *layer = __atomic_load_n(&m_layers, __ATOMIC_ACQUIRE); layer != NULL;
+        layer = __atomic_load_n(&layer->layer_next, __ATOMIC_ACQUIRE))
+   {
+      size_t i = find_compiled(layer, key, len);
+      if (i < layer->count)
+      {
+         return &layer->values[i];
+      }
+   }
+   return NULL;
+}
+
+/*
+ * Looks a lowercased key up by walking the chain: configs chained after
+ * this one take precedence over its own values, and a scope's prefixed keys
+ * over the parent's unprefixed ones, which are only looked at with fallback
+ * set.  Interned keys are looked up in the index instead, which this fills.
+ */
+const tuner_config_value *tuner_config::resolve(const char *key, size_t len, uint32_t hash, bool fallback)
+{
+   const tuner_config_value *value = NULL;
+   tuner_config *next = __atomic_load_n(&m_next, __ATOMIC_ACQUIRE);
+   if (next != NULL)
+   {
+      value = next->resolve(key, len, hash, true);
+   }
+   if (value == NULL)
+   {
+      value = find_own(key, len, hash);
+   }
+   tuner_config *parent = __atomic_load_n(&m_parent, __ATOMIC_ACQUIRE);
+   if ((value == NULL) && (parent != NULL))
+   {
+      string scoped(m_prefix);
+      scoped.append(key, len);
+      value = parent->resolve(scoped.data(), scoped.size(), hash_bytes(m_prefix_hash, key, len), true);
+      if ((value == NULL) && fallback)
+      {
+         value = parent->resolve(key, len, hash, true);
+      }
+   }
+   return value;
+}
+
+int tuner_config::add_config(tuner_config &config)
+{
+   update u;
+   begin_update();
+   tuner_config *tail = this;
+   while ((tail != &config) && (tail->m_next != NULL))
+   {
+      tail = tail->m_next;
+   }
+   if (tail == &config)
+   {
+      end_update(u);
+      return EINVAL;
+   }
+   try
+   {
+      config.m_referrers.push_back(tail);
+   }
+   catch(...)
+   {
+      end_update(u);
+      return ENOMEM;
+   }
+   int error = 0;
+   try
+   {
+      tail->capture_all(u);
+   }
+   catch(...)
+   {
+      LIBTUNERERR << "Unable to queue configuration change notification" << endl;
+   }
+   __atomic_store_n(&tail->m_next, &config, __ATOMIC_RELEASE);
+   try
+   {
+      tail->refresh_all(u);
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+   }
+   end_update(u);
+   return error;
+}
+
+void tuner_config::remove_config(tuner_config &config)
+{
+   update u;
+   begin_update();
+   tuner_config *prev = this;
+   while ((prev->m_next != NULL) && (prev->m_next != &config))
+   {
+      prev = prev->m_next;
+   }
+   if (prev->m_next == &config)
+   {
+      tuner_config *next = config.m_next;
+      try
+      {
+         prev->capture_all(u);
+      }
+      catch(...)
+      {
+         LIBTUNERERR << "Unable to queue configuration change notification" << endl;
+      }
+      try
+      {
+         if (next != NULL)
+         {
+            next->m_referrers.push_back(prev);
+         }
+         config.m_referrers.remove(prev);
+         __atomic_store_n(&prev->m_next, next, __ATOMIC_RELEASE);
+         prev->refresh_all(u);
+      }
+      catch(...)
       {
-         m_next->remove_config(config);  
+         LIBTUNERERR << "Unable to remove configuration from chain" << endl;
       }
    }
+   end_update(u);
 }
 
 string tuner_config::get_store_path(void)
@@ -37,16 +37,23 @@
 #define LIBTUNERERR libtuner_config::errfunc(libtuner_config::errstream)
 #define LIBTUNERLOG libtuner_config::logfunc(libtuner_config::logstream)
 
+#include <stdint.h>
+#include <pthread.h>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <map>
+#include <set>
 #include <list>
+#include <vector>
+#include <limits>
 #include <sstream>
 
 #define LIBTUNER_STORE_PATH_KEY "LIBTUNER_DATA_STORE"
 #define LIBTUNER_DOMAIN_KEY "LIBTUNER_DOMAIN"
 
+#define TUNER_CONFIG_RETIRED_VALUES 256
+
 namespace libtuner_config
 {
    typedef std::ostream& (*outfunc)(std::ostream*);
@@ -61,40 +68,127 @@ namespace libtuner_config
 
 }
 
+class tuner_config;
+
+/*
+ * A configuration value, parsed as a number once when it is set rather
+ * than on every get_number() call.
+ */
+struct tuner_config_value
+{
+   const char *str;
+   bool numeric;
+   int64_t integer;
+   double real;
+};
+
+/*
+ * Handle for a configuration key that is interned once, typically at
+ * static initialization, so that lookups through it need neither a string
+ * allocation nor a map search.  The name must remain valid for the life of
+ * the key.
+ */
+class tuner_config_key
+{
+   public:
+
+      explicit tuner_config_key(const char *name);
+
+      const char *name(void) const
+      {
+         return m_name;
+      }
+
+      size_t id(void) const
+      {
+         return m_id;
+      }
+
+      static const size_t invalid_id = (size_t)-1;
+
+   private:
+
+      friend class tuner_config;
+
+      static uint32_t hash(const char *name);
+
+      const char *m_name;
+
+      size_t m_id;
+
+      uint32_t m_hash;
+};
+
+/*
+ * Notified when the values visible through a config change, whether set on
+ * that config or on one chained after it.  keys holds the lowercased names
+ * of the keys that were added, removed or given a different value.  No
+ * config lock is held, so the listener may look up or change values, but it
+ * runs on whichever thread made the change and should return quickly.
+ */
+class tuner_config_listener
+{
+   public:
+
+      virtual ~tuner_config_listener(void) {}
+
+      virtual void config_changed(tuner_config &config, const std::list<std::string> &keys) = 0;
+};
+
+/*
+ * Lookups take no lock and may run concurrently with set_string(), load_*()
+ * and changes to the config chain.  Each config keeps an index, by interned
+ * key id, of the values visible through it and the configs chained after
+ * it.  A change updates only the index entries for the keys it touched, in
+ * this config and those that see it, so a lookup through a tuner_config_key
+ * costs the same however many configs are chained.  Other keys are found by
+ * walking the chain.  A value replaced or removed is kept until at least
+ * TUNER_CONFIG_RETIRED_VALUES later values have been retired from the same
+ * config, so a string returned by get_string() stays valid for a while
+ * after its key is set again, but should not be held indefinitely.
+ */
 class tuner_config
 {
    public:
 
-      tuner_config(void) : m_next (NULL) {}
+      tuner_config(void);
+
+      /*
+       * A view of parent in which keys under prefix, e.g. "tuner3.", take
+       * precedence over the same keys without it.  Its index holds only the
+       * keys it overrides; any other key is looked up in parent's index.
+       */
+      tuner_config(tuner_config &parent, const char *prefix, int &error);
 
-      virtual ~tuner_config(void) {}
+      virtual ~tuner_config(void);
 
       int load_file(const char *filename);
 
       int load_string(const char *str);
 
       int load_string(const char *str, char line_delim);
+
+      // Writes the values visible through this config in the compiled format.
+      int save_compiled(const char *filename);
+
+      /*
+       * Maps a file written by save_compiled(); nothing is parsed or copied.
+       * Its keys are looked up in the file's sorted key table, and take
+       * precedence over values loaded or set before it.
+       */
+      int load_compiled(const char *filename);
       
       int set_string(const char *key, const char *value);
 
       const char *get_string(const char *key);
+
+      const char *get_string(const tuner_config_key &key);
             
       template <typename numtype> 
       numtype get_number(const char *key, numtype default_val)
       {
-         const char *str = get_string(key);
-         if (str != NULL)
-         {
-            std::string value(str);
-            std::stringstream stream(value);
-            numtype val;
-            stream >> val;
-            return val;
-         }
-         else
-         {
-            return default_val;
-         }
+         tuner_config_value value;
+         return (get_value(key, value) ? to_number<numtype>(value) : default_val);
       }
       
       template <typename numtype> 
@@ -102,6 +196,19 @@ class tuner_config
       {
          return get_number<numtype>(key, (numtype)0);
       }
+
+      template <typename numtype> 
+      numtype get_number(const tuner_config_key &key, numtype default_val)
+      {
+         tuner_config_value value;
+         return (get_value(key, value) ? to_number<numtype>(value) : default_val);
+      }
+
+      template <typename numtype> 
+      numtype get_number(const tuner_config_key &key)
+      {
+         return get_number<numtype>(key, (numtype)0);
+      }
       
       std::string get_file(const char *filename);
       
@@ -111,22 +218,211 @@ class tuner_config
       
       void remove_config(tuner_config &config);
 
+      /*
+       * Environment overrides are read from a snapshot taken on first
+       * lookup.  This re-reads the process environment, e.g. after setenv().
+       * Strings previously returned from the old snapshot become invalid.
+       */
+      static int refresh_environment(void);
+
+      int add_listener(tuner_config_listener &listener);
+
+      // Waits for a call to the listener in progress on another thread.
+      void remove_listener(tuner_config_listener &listener);
+
+      /*
+       * Re-reads a file loaded with load_file() and applies only the
+       * changes.  Keys set since the file was loaded, e.g. by set_string(),
+       * keep their values.
+       */
+      int reload_file(const char *filename);
+
+      // Files loaded into this config and the configs chained after it.
+      int get_files(std::list<std::string> &files);
+
    private:
-      
-      int load(std::istream &stream, char line_delim = '\n');
-      
-      const char *get_config_string(const char *key);
 
-      void set_string(std::string &key, std::string &value);
-        
-      typedef std::map<std::string, std::string> strmap;
+      friend class tuner_config_key;
+
+      struct value_block;
+
+      struct value_slot;
+
+      struct value_table;
+
+      struct key_index;
+
+      struct override_slot;
+
+      struct override_index;
+
+      struct change;
+
+      struct update;
+
+      // A value read from a file, under a key stored in m_table.
+      struct file_value
+      {
+         const char *key;
+         uint32_t len;
+         uint32_t hash;
+         const tuner_config_value *value;
+         value_block *block;
+      };
+
+      // The values read from a file, one per key, in no particular order.
+      typedef std::vector<file_value> file_record;
+
+      // One key/value line, pointing into the text being parsed.
+      struct config_view
+      {
+         const char *key;
+         size_t key_len;
+         const char *value;
+         size_t value_len;
+      };
+
+      static void parse(const char *data, size_t size, char line_delim, std::vector<config_view> &entries);
+
+      int load(const char *data, size_t size, char line_delim, const char *filename);
+
+      int reload(update &u, file_record &old_values, const std::vector<config_view> &entries);
+
+      static size_t intern(const char *name);
+
+      static const tuner_config_value *get_env_value(const char *name, uint32_t hash);
+
+      // Copies the value out while it is known to be live.
+      bool get_value(const char *key, tuner_config_value &value);
+
+      bool get_value(const tuner_config_key &key, tuner_config_value &value);
       
+      const tuner_config_value *get_config_value(const char *key);
+
+      const tuner_config_value *get_config_value(const tuner_config_key &key);
+
+      bool find_indexed(size_t id, const tuner_config_value *&value);
+
+      const tuner_config_value *find_own(const char *key, size_t len, uint32_t hash);
+
+      const tuner_config_value *resolve(const char *key, size_t len, uint32_t hash, bool fallback);
+
+      template <typename numtype> 
+      static numtype to_number(const tuner_config_value &value)
+      {
+         if (std::numeric_limits<numtype>::is_integer)
+         {
+            return (numtype)value.integer;
+         }
+         else
+         {
+            return (numtype)value.real;
+         }
+      }
+
+      tuner_config(const tuner_config&);
+
+      tuner_config &operator=(const tuner_config&);
+
+      static void begin_update(void);
+
+      static void end_update(update &u);
+
+      static void queue_notifications(update &u);
+
+      void link(void);
+
+      void unlink(void);
+
+      void reserve(update &u, size_t count);
+
+      value_slot *insert_key(update &u, const char *key, size_t len, uint32_t hash);
+
+      value_slot *find_slot(const char *key, size_t len, uint32_t hash);
+
+      const char *store_key(const char *key, size_t len);
+
+      void set_slot(update &u, value_slot *slot, const tuner_config_value *value, value_block *block);
+
+      static value_block *new_block(size_t size, size_t count);
+
+      static void free_block(value_block *block);
+
+      void adopt(value_block *block);
+
+      void release(update &u, value_block *block);
+
+      void add_layer(update &u, value_block *layer);
+
+      void update_index(update &u, bool all);
+
+      void set_override(update &u, size_t id, const tuner_config_value *value);
+
+      void propagate(update &u, const char *key, size_t len, uint32_t hash, bool capture);
+
+      void refresh_all(update &u);
+
+      void capture_all(update &u);
+
+      bool has_listeners(void);
+
+      void enumerate(std::set<std::string> &names);
+
       std::string get_store_path(void);
-      
-      strmap m_map;
+
+      // This config's own values; replaced by a larger copy as it fills.
+      value_table *m_table;
+
+      key_index *m_index;
+
+      // Used instead of m_index by a scope.
+      override_index *m_overrides;
+
+      // Compiled files loaded into this config, newest first.
+      value_block *m_layers;
+
+      // Blocks still referred to by m_table, m_layers or m_files.
+      value_block *m_blocks;
+
+      // Blocks no longer referred to, oldest first.
+      value_block *m_retired;
+
+      value_block *m_retired_tail;
+
+      // Values retired so far, to age retired blocks.
+      size_t m_retired_count;
+
+      // Storage for the keys in m_table, which are never freed before it.
+      std::vector<char*> m_key_chunks;
+
+      char *m_key_free;
+
+      size_t m_key_avail;
+
+      // Configs whose m_next is this one.
+      std::list<tuner_config*> m_referrers;
+
+      // Scoped views of this config.
+      std::list<tuner_config*> m_scopes;
+
+      std::list<tuner_config_listener*> m_listeners;
+
+      // Keys and values last read from each file passed to load_file().
+      std::map<std::string, file_record> m_files;
       
       tuner_config *m_next;
 
+      tuner_config *m_parent;
+
+      std::string m_prefix;
+
+      uint32_t m_prefix_hash;
+
+      // Every config, so that keys interned later get an index entry in each.
+      tuner_config *m_all_prev;
+
+      tuner_config *m_all_next;
+
 };
 
 #endif
@@ -0,0 +1,65 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_CONFIG_COMPILED_H__
+#define __TUNER_CONFIG_COMPILED_H__
+
+#include <stdint.h>
+
+/*
+ * Compiled config file layout, written by tuner_config::save_compiled() and
+ * mapped by tuner_config::load_compiled().  All fields are in host byte
+ * order.
+ *
+ * The file starts with a tuner_config_compiled_header, followed by num_keys
+ * tuner_config_compiled_key entries sorted by key, then pool_size bytes of
+ * NUL-terminated strings.  Keys are stored lowercased.  String offsets are
+ * relative to the start of the pool.
+ */
+
+#define TUNER_CONFIG_COMPILED_MAGIC   0x4743544CU
+#define TUNER_CONFIG_COMPILED_VERSION 1
+
+typedef struct
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t num_keys;
+   uint32_t pool_size;
+} tuner_config_compiled_header;
+
+typedef struct
+{
+   uint32_t key_offset;
+   uint32_t value_offset;
+   uint32_t numeric;
+   uint32_t reserved;
+   int64_t integer;
+   double real;
+} tuner_config_compiled_key;
+
+#endif
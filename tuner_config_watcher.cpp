@@ -0,0 +1,358 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <list>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#else
+#include <sys/event.h>
+#endif
+#include "tuner_config_watcher.h"
+
+using namespace std;
+
+tuner_config_watcher::tuner_config_watcher(tuner_config &config, int &error)
+   : m_config(config),
+     m_fd(-1),
+     m_started(false)
+{
+   m_wake[0] = m_wake[1] = -1;
+   if (error)
+   {
+      return;
+   }
+   list<string> files;
+   error = m_config.get_files(files);
+   if (error)
+   {
+      return;
+   }
+#ifdef __linux__
+   m_fd = inotify_init();
+#else
+   m_fd = kqueue();
+#endif
+   if ((m_fd < 0) || (pipe(m_wake) < 0))
+   {
+      error = errno;
+      LIBTUNERERR << "Unable to create config file watcher: " << strerror(errno) << endl;
+      return;
+   }
+   try
+   {
+      m_files.resize(files.size());
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+      return;
+   }
+   size_t i = 0;
+   for (list<string>::iterator it = files.begin(); !error && (it != files.end()); ++it, ++i)
+   {
+      m_files[i].path = *it;
+      string::size_type slash = it->rfind('/');
+      m_files[i].name = ((slash == string::npos) ? *it : it->substr(slash + 1));
+      m_files[i].handle = -1;
+      m_files[i].settle_at = 0;
+      error = add_watch(m_files[i]);
+   }
+#ifndef __linux__
+   if (!error)
+   {
+      struct kevent ev;
+      EV_SET(&ev, m_wake[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+      if (kevent(m_fd, &ev, 1, NULL, 0, NULL) < 0)
+      {
+         error = errno;
+      }
+   }
+#endif
+   if (!error)
+   {
+      error = pthread_create(&m_thread, NULL, watch_thread, this);
+      m_started = (error == 0);
+   }
+}
+
+tuner_config_watcher::~tuner_config_watcher(void)
+{
+   if (m_started)
+   {
+      char c = 0;
+      write(m_wake[1], &c, 1);
+      pthread_join(m_thread, NULL);
+   }
+#ifndef __linux__
+   for (size_t i = 0; i < m_files.size(); ++i)
+   {
+      if (m_files[i].handle >= 0)
+      {
+         close(m_files[i].handle);
+      }
+   }
+#endif
+   if (m_fd >= 0)
+   {
+      close(m_fd);
+   }
+   if (m_wake[0] >= 0)
+   {
+      close(m_wake[0]);
+      close(m_wake[1]);
+   }
+}
+
+void *tuner_config_watcher::watch_thread(void *arg)
+{
+   static_cast<tuner_config_watcher*>(arg)->watch();
+   return NULL;
+}
+
+#ifdef __linux__
+
+/*
+ * Editors commonly replace a file by renaming a new one over it, which a
+ * watch on the file itself would lose, so the containing directory is
+ * watched instead.
+ */
+int tuner_config_watcher::add_watch(watched_file &file)
+{
+   string dir(".");
+   string::size_type slash = file.path.rfind('/');
+   if (slash != string::npos)
+   {
+      dir = ((slash == 0) ? string("/") : file.path.substr(0, slash));
+   }
+   file.handle = inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+   if (file.handle < 0)
+   {
+      LIBTUNERERR << "Unable to watch " << dir << ": " << strerror(errno) << endl;
+      return errno;
+   }
+   return 0;
+}
+
+void tuner_config_watcher::watch(void)
+{
+   char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+   struct pollfd fds[2];
+   fds[0].fd = m_fd;
+   fds[0].events = POLLIN;
+   fds[1].fd = m_wake[0];
+   fds[1].events = POLLIN;
+   for (;;)
+   {
+      fds[0].revents = fds[1].revents = 0;
+      if (poll(fds, 2, -1) < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         break;
+      }
+      if (fds[1].revents != 0)
+      {
+         break;
+      }
+      ssize_t len = read(m_fd, buf, sizeof(buf));
+      if ((len < 0) && (errno == EINTR))
+      {
+         continue;
+      }
+      if (len <= 0)
+      {
+         LIBTUNERERR << "Config file watcher stopped: " << ((len < 0) ? strerror(errno) : "end of inotify events") << endl;
+         break;
+      }
+      for (char *pos = buf; pos < (buf + len); pos += sizeof(struct inotify_event) + ((struct inotify_event*)pos)->len)
+      {
+         const struct inotify_event *event = (const struct inotify_event*)pos;
+         if (event->mask & IN_Q_OVERFLOW)
+         {
+            // Events were dropped, so any of the files may have changed.
+            for (size_t i = 0; i < m_files.size(); ++i)
+            {
+               reload(m_files[i]);
+            }
+            continue;
+         }
+         for (size_t i = 0; (event->len > 0) && (i < m_files.size()); ++i)
+         {
+            if ((m_files[i].handle == event->wd) && (m_files[i].name == event->name))
+            {
+               reload(m_files[i]);
+            }
+         }
+      }
+   }
+}
+
+#else
+
+#ifdef NOTE_CLOSE_WRITE
+// Reload once the writer closes the file, never while it is part written.
+#define WATCH_WRITE_FLAGS NOTE_CLOSE_WRITE
+#else
+// Without close events, reload once writes have stopped for WATCH_SETTLE_MS.
+#define WATCH_WRITE_FLAGS (NOTE_WRITE | NOTE_EXTEND)
+#define WATCH_SETTLE_MS 200
+#endif
+
+#define WATCH_RETRY_MS 500
+
+static uint64_t now_ms(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+int tuner_config_watcher::add_watch(watched_file &file)
+{
+   file.handle = open(file.path.c_str(), O_RDONLY);
+   if (file.handle < 0)
+   {
+      LIBTUNERERR << "Unable to watch " << file.path << ": " << strerror(errno) << endl;
+      return errno;
+   }
+   struct kevent ev;
+   EV_SET(&ev, file.handle, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+      WATCH_WRITE_FLAGS | NOTE_DELETE | NOTE_RENAME, 0, &file);
+   if (kevent(m_fd, &ev, 1, NULL, 0, NULL) < 0)
+   {
+      int error = errno;
+      close(file.handle);
+      file.handle = -1;
+      return error;
+   }
+   return 0;
+}
+
+/*
+ * A file that is deleted, or renamed away before its replacement is in
+ * place, can't be watched until it reappears, so it is retried periodically
+ * and reloaded once it does.
+ */
+void tuner_config_watcher::watch(void)
+{
+   struct kevent events[8];
+   for (;;)
+   {
+      uint64_t now = now_ms();
+      uint64_t wait_ms = 0;
+      bool timed = false;
+      for (size_t i = 0; i < m_files.size(); ++i)
+      {
+         if (m_files[i].handle < 0)
+         {
+            if ((access(m_files[i].path.c_str(), R_OK) == 0) && (add_watch(m_files[i]) == 0))
+            {
+               m_files[i].settle_at = 0;
+               reload(m_files[i]);
+            }
+            else if (!timed || (wait_ms > WATCH_RETRY_MS))
+            {
+               wait_ms = WATCH_RETRY_MS;
+               timed = true;
+            }
+         }
+         else if (m_files[i].settle_at != 0)
+         {
+            if (m_files[i].settle_at <= now)
+            {
+               m_files[i].settle_at = 0;
+               reload(m_files[i]);
+            }
+            else if (!timed || (wait_ms > (m_files[i].settle_at - now)))
+            {
+               wait_ms = m_files[i].settle_at - now;
+               timed = true;
+            }
+         }
+      }
+      struct timespec timeout;
+      timeout.tv_sec = (time_t)(wait_ms / 1000);
+      timeout.tv_nsec = (long)((wait_ms % 1000) * 1000000);
+      int num_events = kevent(m_fd, NULL, 0, events, 8, (timed ? &timeout : NULL));
+      if (num_events < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         break;
+      }
+      for (int i = 0; i < num_events; ++i)
+      {
+         if (events[i].filter == EVFILT_READ)
+         {
+            return;
+         }
+         watched_file &file = *static_cast<watched_file*>(events[i].udata);
+         if (events[i].fflags & (NOTE_DELETE | NOTE_RENAME))
+         {
+            // The file was replaced; follow the new one at the same path.
+            close(file.handle);
+            file.handle = -1;
+            file.settle_at = 0;
+            if ((access(file.path.c_str(), R_OK) != 0) || (add_watch(file) != 0))
+            {
+               continue;
+            }
+            reload(file);
+         }
+         else
+         {
+#ifdef NOTE_CLOSE_WRITE
+            reload(file);
+#else
+            file.settle_at = now_ms() + WATCH_SETTLE_MS;
+#endif
+         }
+      }
+   }
+}
+
+#endif
+
+void tuner_config_watcher::reload(watched_file &file)
+{
+   int error = m_config.reload_file(file.path.c_str());
+   if (error)
+   {
+      LIBTUNERERR << "Unable to reload " << file.path << ": " << strerror(error) << endl;
+   }
+}
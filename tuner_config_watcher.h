@@ -0,0 +1,78 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_CONFIG_WATCHER_H__
+#define __TUNER_CONFIG_WATCHER_H__
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "tuner_config.h"
+
+/*
+ * Watches the files loaded into a config chain with load_file() and
+ * reloads each one when it is rewritten, using inotify on Linux and kqueue
+ * elsewhere.  A file is reloaded once its writer closes it, or where kqueue
+ * can't report that, once writes to it have stopped for a moment.  Only the keys that changed are applied, and listeners on the
+ * config are notified of them from the watcher thread.
+ */
+class tuner_config_watcher
+{
+   public:
+
+      tuner_config_watcher(tuner_config &config, int &error);
+
+      virtual ~tuner_config_watcher(void);
+
+   private:
+
+      struct watched_file
+      {
+         std::string path;
+         std::string name;
+         int handle;
+         // When to reload a file still being written, or 0.
+         uint64_t settle_at;
+      };
+
+      static void *watch_thread(void *arg);
+
+      int add_watch(watched_file &file);
+
+      void watch(void);
+
+      void reload(watched_file &file);
+
+      tuner_config &m_config;
+      std::vector<watched_file> m_files;
+      int m_fd;
+      int m_wake[2];
+      pthread_t m_thread;
+      bool m_started;
+};
+
+#endif
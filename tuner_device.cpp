@@ -26,8 +26,42 @@
  */
 
 #include <sys/errno.h>
+#include <string.h>
+#include <time.h>
+#include <new>
 #include "tuner_device.h"
 
+int tuner_device::write(const struct iovec *iov, size_t iovcnt)
+{
+   size_t total = 0;
+   for (size_t i = 0; i < iovcnt; ++i)
+   {
+      total += iov[i].iov_len;
+   }
+   uint8_t stackbuf[256];
+   uint8_t *buffer = stackbuf;
+   if (total > sizeof(stackbuf))
+   {
+      buffer = new(std::nothrow) uint8_t[total];
+      if (buffer == NULL)
+      {
+         return ENOMEM;
+      }
+   }
+   size_t offset = 0;
+   for (size_t i = 0; i < iovcnt; ++i)
+   {
+      memcpy(buffer + offset, iov[i].iov_base, iov[i].iov_len);
+      offset += iov[i].iov_len;
+   }
+   int error = write(buffer, total);
+   if (buffer != stackbuf)
+   {
+      delete[] buffer;
+   }
+   return error;
+}
+
 int tuner_device::write_array(const uint8_t *buffer, size_t elem_size, size_t total_size)
 {
    int error = 0;
@@ -35,6 +69,10 @@ int tuner_device::write_array(const uint8_t *buffer, size_t elem_size, size_t to
    {
       return EINVAL;
    }
+   if (m_write_combining && (elem_size > 1))
+   {
+      return write_combined(buffer, elem_size, total_size);
+   }
    for (size_t i = 0; i < total_size; i += elem_size)
    {
       if ((error = write(buffer + i, elem_size)))
@@ -62,6 +100,67 @@ int tuner_device::read_array(uint8_t *buffer, size_t elem_size, size_t total_siz
    return error;
 }
 
+int tuner_device::write_combined(const uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   if ((elem_size < 2) || ((total_size % elem_size) != 0))
+   {
+      return EINVAL;
+   }
+   size_t num_elems = total_size / elem_size;
+   size_t max_transfer = max_transfer_size();
+   uint8_t stackbuf[256];
+   tuner_op stackops[32];
+   uint8_t *merged = stackbuf;
+   tuner_op *ops = stackops;
+   if (total_size > sizeof(stackbuf))
+   {
+      merged = new(std::nothrow) uint8_t[total_size];
+   }
+   if (num_elems > (sizeof(stackops) / sizeof(stackops[0])))
+   {
+      ops = new(std::nothrow) tuner_op[num_elems];
+   }
+   int error = 0;
+   if ((merged == NULL) || (ops == NULL))
+   {
+      error = ENOMEM;
+   }
+   size_t num_ops = 0, offset = 0;
+   for (size_t i = 0; !error && (i < total_size); i += elem_size)
+   {
+      const uint8_t *elem = buffer + i;
+      if ((num_ops > 0) && (elem[0] == (buffer[i - elem_size] + 1)) &&
+          ((max_transfer == 0) || ((ops[num_ops - 1].write_size + elem_size - 1) <= max_transfer)))
+      {
+         memcpy(merged + offset, elem + 1, elem_size - 1);
+         offset += (elem_size - 1);
+         ops[num_ops - 1].write_size += (elem_size - 1);
+         continue;
+      }
+      ops[num_ops].type = TUNER_OP_WRITE;
+      ops[num_ops].write_buffer = merged + offset;
+      ops[num_ops].write_size = elem_size;
+      ops[num_ops].read_buffer = NULL;
+      ops[num_ops].read_size = 0;
+      ++num_ops;
+      memcpy(merged + offset, elem, elem_size);
+      offset += elem_size;
+   }
+   if (!error)
+   {
+      error = submit(ops, num_ops);
+   }
+   if ((merged != NULL) && (merged != stackbuf))
+   {
+      delete[] merged;
+   }
+   if ((ops != NULL) && (ops != stackops))
+   {
+      delete[] ops;
+   }
+   return error;
+}
+
 int tuner_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
 {
    int error = write(write_buffer, write_size);
@@ -71,3 +170,134 @@ int tuner_device::transact(const uint8_t *write_buffer, size_t write_size, uint8
    }
    return read(read_buffer, read_size);
 }
+
+int tuner_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   int error = 0;
+   for (size_t i = 0; !error && (i < num_ops); ++i)
+   {
+      switch (ops[i].type)
+      {
+         case TUNER_OP_WRITE:
+            error = write(ops[i].write_buffer, ops[i].write_size);
+            break;
+         case TUNER_OP_READ:
+            error = read(ops[i].read_buffer, ops[i].read_size);
+            break;
+         case TUNER_OP_TRANSACT:
+            error = transact(ops[i].write_buffer, ops[i].write_size, ops[i].read_buffer, ops[i].read_size);
+            break;
+         default:
+            error = EINVAL;
+            break;
+      }
+   }
+   return error;
+}
+
+int tuner_device::update_bits(uint8_t reg, uint8_t mask, uint8_t value)
+{
+   bus_lock lock(*this);
+   uint8_t buffer[2];
+   buffer[0] = reg;
+   int error = transact(buffer, 1, buffer + 1, 1);
+   if (error)
+   {
+      return error;
+   }
+   uint8_t updated = (buffer[1] & ~mask) | (value & mask);
+   if (updated == buffer[1])
+   {
+      return 0;
+   }
+   buffer[1] = updated;
+   return write(buffer, sizeof(buffer));
+}
+
+int tuner_device::update_bits16(uint8_t reg, uint16_t mask, uint16_t value)
+{
+   bus_lock lock(*this);
+   uint8_t buffer[3];
+   buffer[0] = reg;
+   int error = transact(buffer, 1, buffer + 1, 2);
+   if (error)
+   {
+      return error;
+   }
+   uint16_t current = ((uint16_t)buffer[1] << 8) | buffer[2];
+   uint16_t updated = (current & ~mask) | (value & mask);
+   if (updated == current)
+   {
+      return 0;
+   }
+   buffer[1] = (updated >> 8) & 0xFF;
+   buffer[2] = updated & 0xFF;
+   return write(buffer, sizeof(buffer));
+}
+
+uint64_t tuner_device::io_begin(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+void tuner_device::io_end(tuner_stat_op op, uint64_t start, int error, size_t written, size_t read)
+{
+   uint64_t elapsed = io_begin() - start;
+   size_t bucket = 0;
+   if (elapsed > 0)
+   {
+      bucket = 64 - __builtin_clzll(elapsed);
+      if (bucket >= TUNER_STAT_LATENCY_BUCKETS)
+      {
+         bucket = TUNER_STAT_LATENCY_BUCKETS - 1;
+      }
+   }
+   tuner_op_stats &stats = m_stats.ops[op];
+   __atomic_fetch_add(&stats.count, 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&stats.latency[bucket], 1, __ATOMIC_RELAXED);
+   if (error)
+   {
+      __atomic_fetch_add(&stats.errors, 1, __ATOMIC_RELAXED);
+      return;
+   }
+   if (written > 0)
+   {
+      __atomic_fetch_add(&m_stats.bytes_written, written, __ATOMIC_RELAXED);
+   }
+   if (read > 0)
+   {
+      __atomic_fetch_add(&m_stats.bytes_read, read, __ATOMIC_RELAXED);
+   }
+}
+
+void tuner_device::get_stats(tuner_device_stats &stats)
+{
+   stats.bytes_written = __atomic_load_n(&m_stats.bytes_written, __ATOMIC_RELAXED);
+   stats.bytes_read = __atomic_load_n(&m_stats.bytes_read, __ATOMIC_RELAXED);
+   for (size_t i = 0; i < TUNER_STAT_NUM_OPS; ++i)
+   {
+      stats.ops[i].count = __atomic_load_n(&m_stats.ops[i].count, __ATOMIC_RELAXED);
+      stats.ops[i].errors = __atomic_load_n(&m_stats.ops[i].errors, __ATOMIC_RELAXED);
+      for (size_t j = 0; j < TUNER_STAT_LATENCY_BUCKETS; ++j)
+      {
+         stats.ops[i].latency[j] = __atomic_load_n(&m_stats.ops[i].latency[j], __ATOMIC_RELAXED);
+      }
+   }
+}
+
+void tuner_device::reset_stats(void)
+{
+   __atomic_store_n(&m_stats.bytes_written, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&m_stats.bytes_read, 0, __ATOMIC_RELAXED);
+   for (size_t i = 0; i < TUNER_STAT_NUM_OPS; ++i)
+   {
+      __atomic_store_n(&m_stats.ops[i].count, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&m_stats.ops[i].errors, 0, __ATOMIC_RELAXED);
+      for (size_t j = 0; j < TUNER_STAT_LATENCY_BUCKETS; ++j)
+      {
+         __atomic_store_n(&m_stats.ops[i].latency[j], 0, __ATOMIC_RELAXED);
+      }
+   }
+}
@@ -29,15 +29,64 @@
 #define __TUNER_DEVICE_H__
 
 #include <sys/types.h>
+#include <sys/errno.h>
+#include <sys/uio.h>
 #include "tuner_config.h"
 
+enum tuner_op_type
+{
+   TUNER_OP_WRITE,
+   TUNER_OP_READ,
+   TUNER_OP_TRANSACT
+};
+
+typedef struct
+{
+   tuner_op_type type;
+   const uint8_t *write_buffer;
+   size_t write_size;
+   uint8_t *read_buffer;
+   size_t read_size;
+} tuner_op;
+
+enum tuner_stat_op
+{
+   TUNER_STAT_WRITE,
+   TUNER_STAT_READ,
+   TUNER_STAT_TRANSACT,
+   TUNER_STAT_SUBMIT,
+   TUNER_STAT_NUM_OPS
+};
+
+#define TUNER_STAT_LATENCY_BUCKETS 24
+
+/*
+ * latency[0] counts operations that completed in under 1us, latency[i]
+ * those that took [2^(i-1), 2^i) us.  The last bucket is open-ended.
+ */
+typedef struct
+{
+   uint64_t count;
+   uint64_t errors;
+   uint64_t latency[TUNER_STAT_LATENCY_BUCKETS];
+} tuner_op_stats;
+
+typedef struct
+{
+   uint64_t bytes_written;
+   uint64_t bytes_read;
+   tuner_op_stats ops[TUNER_STAT_NUM_OPS];
+} tuner_device_stats;
+
 class tuner_device
 {
 
    public:
 
       tuner_device(tuner_config &config)
-         : m_config(config)
+         : m_config(config),
+           m_write_combining(false),
+           m_stats()
       {}
 
       virtual ~tuner_device(void) {}
@@ -57,16 +106,154 @@ class tuner_device
          size_t transferred = 0;
          return read(buffer, size, transferred);
       }
+
+      virtual int write(const struct iovec *iov, size_t iovcnt);
       
       virtual int write_array(const uint8_t *buffer, size_t elem_size, size_t total_size);
       
       virtual int read_array(uint8_t *buffer, size_t elem_size, size_t total_size);
 
       virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
+
+      /*
+       * Runs a sequence of operations, as a single bus transaction if the
+       * backend supports it.  Stops at the first failed operation.
+       */
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      /*
+       * Read-modify-write of an 8-bit or big-endian 16-bit register,
+       * addressed by a single byte.  The bus is held across the read and
+       * the write, and the write is skipped if nothing changes.
+       */
+      virtual int update_bits(uint8_t reg, uint8_t mask, uint8_t value);
+
+      virtual int update_bits16(uint8_t reg, uint16_t mask, uint16_t value);
+
+      /*
+       * Bus clock control, for transports that allow it.  Other devices on
+       * the same bus are affected too.  EOPNOTSUPP if not supported.
+       */
+      virtual int set_bus_speed(uint32_t hz)
+      {
+         return EOPNOTSUPP;
+      }
+
+      virtual int get_bus_speed(uint32_t &hz)
+      {
+         return EOPNOTSUPP;
+      }
+
+      /*
+       * Runs the bus at the given clock for the lifetime of the object, and
+       * restores the previous clock afterwards.  0 leaves the clock alone.
+       */
+      class bus_speed
+      {
+         public:
+
+            bus_speed(tuner_device &device, uint32_t hz)
+               : m_device(device),
+                 m_saved_hz(0)
+            {
+               if ((hz != 0) && !m_device.get_bus_speed(m_saved_hz) && (m_saved_hz != hz))
+               {
+                  if (m_device.set_bus_speed(hz))
+                  {
+                     m_saved_hz = 0;
+                  }
+               }
+               else
+               {
+                  m_saved_hz = 0;
+               }
+            }
+
+            ~bus_speed(void)
+            {
+               if (m_saved_hz != 0)
+               {
+                  m_device.set_bus_speed(m_saved_hz);
+               }
+            }
+
+         private:
+
+            tuner_device &m_device;
+            uint32_t m_saved_hz;
+      };
+
+      /*
+       * Hold the underlying bus across several operations.  Calls nest.
+       */
+      virtual void lock_bus(void) {}
+
+      virtual void unlock_bus(void) {}
+
+      class bus_lock
+      {
+         public:
+
+            bus_lock(tuner_device &device)
+               : m_device(device)
+            {
+               m_device.lock_bus();
+            }
+
+            ~bus_lock(void)
+            {
+               m_device.unlock_bus();
+            }
+
+         private:
+
+            tuner_device &m_device;
+      };
+
+      /*
+       * Largest single write, including any register address bytes, the
+       * transport accepts.  0 if unknown, in which case callers fall back
+       * to their own conservative transfer size.
+       */
+      virtual size_t max_transfer_size(void)
+      {
+         return 0;
+      }
+
+      /*
+       * When enabled, write_array() merges elements of the form
+       * [reg, value...] that address consecutive registers into one
+       * auto-incrementing write, and sends the result as a single batch.
+       * Runs are split at max_transfer_size().  Only enable this for chips
+       * with register address auto-increment.  Devices that wrap another
+       * pass the setting on to it.
+       */
+      virtual void set_write_combining(bool enable)
+      {
+         m_write_combining = enable;
+      }
+
+      void get_stats(tuner_device_stats &stats);
+
+      void reset_stats(void);
       
    protected:
 
+      /*
+       * Backends bracket each transaction they put on the bus with these.
+       */
+      static uint64_t io_begin(void);
+
+      void io_end(tuner_stat_op op, uint64_t start, int error, size_t written, size_t read);
+
+      int write_combined(const uint8_t *buffer, size_t elem_size, size_t total_size);
+
       tuner_config &m_config;
+      bool m_write_combining;
+
+   private:
+
+      tuner_device_stats m_stats;
 
 };
 
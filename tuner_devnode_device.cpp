@@ -31,11 +31,16 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include "tuner_devnode_device.h"
 
 tuner_devnode_device::tuner_devnode_device(tuner_config &config, const char *devnode, int &error)
    : tuner_device(config),
-     m_devnode_fd(-1)
+     m_devnode_fd(-1),
+     m_bus(NULL),
+     m_priority(TUNER_BUS_PRIORITY_NORMAL),
+     m_timeout_ms(0),
+     m_nonblocking(false)
 {
    if (error)
    {
@@ -48,35 +53,205 @@ tuner_devnode_device::tuner_devnode_device(tuner_config &config, const char *dev
    }
 }
 
+tuner_devnode_device::tuner_devnode_device(tuner_config &config, tuner_bus &bus, int &error)
+   : tuner_device(config),
+     m_devnode_fd(bus.fd()),
+     m_bus(&bus),
+     m_priority(TUNER_BUS_PRIORITY_NORMAL),
+     m_timeout_ms(0),
+     m_nonblocking(false)
+{}
+
 tuner_devnode_device::~tuner_devnode_device(void)
 {
-   if (m_devnode_fd >= 0)
+   if ((m_bus == NULL) && (m_devnode_fd >= 0))
    {
       close(m_devnode_fd);
    }
 }
 
+int tuner_devnode_device::lock_bus_until(uint64_t deadline)
+{
+   bool switched = false;
+   if (m_bus == NULL)
+   {
+      return 0;
+   }
+   int error = m_bus->acquire(this, m_priority, deadline, switched);
+   if (!error && switched)
+   {
+      select_device();
+   }
+   return error;
+}
+
+/*
+ * Waits until the fd is ready for the given events, or the deadline
+ * (from io_begin(), 0 for none) passes.
+ */
+int tuner_devnode_device::wait_ready(short events, uint64_t deadline)
+{
+   struct pollfd pfd;
+   pfd.fd = m_devnode_fd;
+   pfd.events = events;
+   for (;;)
+   {
+      int timeout = -1;
+      if (deadline != 0)
+      {
+         uint64_t now = io_begin();
+         if (now >= deadline)
+         {
+            return ETIMEDOUT;
+         }
+         timeout = (int)(((deadline - now) + 999) / 1000);
+      }
+      pfd.revents = 0;
+      int retval = poll(&pfd, 1, timeout);
+      if (retval > 0)
+      {
+         return 0;
+      }
+      else if (retval == 0)
+      {
+         return ETIMEDOUT;
+      }
+      else if (errno != EINTR)
+      {
+         return errno;
+      }
+   }
+}
+
 int tuner_devnode_device::write(const uint8_t *buffer, size_t size, size_t &written)
 {
-   ssize_t retval = ::write(m_devnode_fd, buffer, size);
-   if (retval == (ssize_t)-1)
+   int error = 0;
+   io_lock lock(*this, error);
+   uint64_t start = io_begin();
+   bool wait = (m_nonblocking || (lock.deadline() != 0));
+   ssize_t retval = -1;
+   while (!error)
+   {
+      if (wait && (error = wait_ready(POLLOUT, lock.deadline())))
+      {
+         break;
+      }
+      if ((retval = ::write(m_devnode_fd, buffer, size)) != (ssize_t)-1)
+      {
+         break;
+      }
+      error = errno;
+      if ((error == EAGAIN) || (error == EINTR))
+      {
+         error = 0;
+         wait = true;
+      }
+   }
+   if (error)
    {
-      LIBTUNERERR << "Unable to write to device: " << strerror(errno) << std::endl;
-      return errno;
+      io_end(TUNER_STAT_WRITE, start, error, 0, 0);
+      LIBTUNERERR << "Unable to write to device: " << strerror(error) << std::endl;
+      return error;
    }
+   io_end(TUNER_STAT_WRITE, start, 0, retval, 0);
    written = retval;
    return 0;
 }
 
+int tuner_devnode_device::write(const struct iovec *iov, size_t iovcnt)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   uint64_t start = io_begin();
+   bool wait = (m_nonblocking || (lock.deadline() != 0));
+   ssize_t retval = -1;
+   while (!error)
+   {
+      if (wait && (error = wait_ready(POLLOUT, lock.deadline())))
+      {
+         break;
+      }
+      if ((retval = ::writev(m_devnode_fd, iov, (int)iovcnt)) != (ssize_t)-1)
+      {
+         break;
+      }
+      error = errno;
+      if ((error == EAGAIN) || (error == EINTR))
+      {
+         error = 0;
+         wait = true;
+      }
+   }
+   if (error)
+   {
+      io_end(TUNER_STAT_WRITE, start, error, 0, 0);
+      LIBTUNERERR << "Unable to write to device: " << strerror(error) << std::endl;
+      return error;
+   }
+   io_end(TUNER_STAT_WRITE, start, 0, retval, 0);
+   return 0;
+}
+
 int tuner_devnode_device::read(uint8_t *buffer, size_t size, size_t &read)
 {
-   ssize_t retval = ::read(m_devnode_fd, buffer, size);
-   if (retval == ssize_t(-1))
+   int error = 0;
+   io_lock lock(*this, error);
+   uint64_t start = io_begin();
+   bool wait = (m_nonblocking || (lock.deadline() != 0));
+   ssize_t retval = -1;
+   while (!error)
    {
-      LIBTUNERERR << "Unable to read from device: " << strerror(errno) << std::endl;
-      return errno;
+      if (wait && (error = wait_ready(POLLIN, lock.deadline())))
+      {
+         break;
+      }
+      if ((retval = ::read(m_devnode_fd, buffer, size)) != (ssize_t)-1)
+      {
+         break;
+      }
+      error = errno;
+      if ((error == EAGAIN) || (error == EINTR))
+      {
+         error = 0;
+         wait = true;
+      }
    }
+   if (error)
+   {
+      io_end(TUNER_STAT_READ, start, error, 0, 0);
+      LIBTUNERERR << "Unable to read from device: " << strerror(error) << std::endl;
+      return error;
+   }
+   io_end(TUNER_STAT_READ, start, 0, 0, retval);
    read = retval;
    return 0;
 }
 
+
+int tuner_devnode_device::write_array(const uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   return (error ? error : tuner_device::write_array(buffer, elem_size, total_size));
+}
+
+int tuner_devnode_device::read_array(uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   return (error ? error : tuner_device::read_array(buffer, elem_size, total_size));
+}
+
+int tuner_devnode_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   return (error ? error : tuner_device::transact(write_buffer, write_size, read_buffer, read_size));
+}
+
+int tuner_devnode_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   return (error ? error : tuner_device::submit(ops, num_ops));
+}
@@ -29,6 +29,7 @@
 #define __TUNER_DEVNODE_DEVICE_H__
 
 #include "tuner_device.h"
+#include "tuner_bus.h"
 
 class tuner_devnode_device
    : public tuner_device
@@ -37,15 +38,137 @@ class tuner_devnode_device
 
       tuner_devnode_device(tuner_config &config, const char *devnode, int &error);
 
+      tuner_devnode_device(tuner_config &config, tuner_bus &bus, int &error);
+
       virtual ~tuner_devnode_device(void);
 
       virtual int write(const uint8_t *buffer, size_t size, size_t &written);
 
+      virtual int write(const struct iovec *iov, size_t iovcnt);
+
       virtual int read(uint8_t *buffer, size_t size, size_t &read);
 
+      virtual int write_array(const uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int read_array(uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
+
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      void set_priority(tuner_bus_priority priority)
+      {
+         m_priority = priority;
+      }
+
+      /*
+       * In non-blocking mode read() and write() poll() for readiness before
+       * each transfer, so the fd may also be registered with poll/epoll/kqueue
+       * by the caller.  The fd's own flags are never changed, since a bus fd
+       * is shared with the other devices on the bus.
+       */
+      void set_nonblocking(bool nonblocking)
+      {
+         m_nonblocking = nonblocking;
+      }
+
+      int fd(void)
+      {
+         return m_devnode_fd;
+      }
+
+      /*
+       * Per-operation deadline, 0 for none.  It covers the wait for a shared
+       * bus and, for read() and write(), a poll() for readiness before each
+       * transfer; an operation that can't complete in time fails with
+       * ETIMEDOUT.  Subclasses doing ioctl-based transfers bound those as
+       * far as their interface allows.
+       */
+      virtual int set_timeout(uint32_t timeout_ms)
+      {
+         m_timeout_ms = timeout_ms;
+         return 0;
+      }
+
+      virtual void lock_bus(void)
+      {
+         if ((m_bus != NULL) && m_bus->acquire(this, m_priority))
+         {
+            select_device();
+         }
+      }
+
+      virtual void unlock_bus(void)
+      {
+         if (m_bus != NULL)
+         {
+            m_bus->release();
+         }
+      }
+
    protected:
 
+      /*
+       * Holds the bus for one operation, giving up once the operation's
+       * deadline passes; error is set to ETIMEDOUT in that case.
+       */
+      class io_lock
+      {
+         public:
+
+            io_lock(tuner_devnode_device &device, int &error)
+               : m_device(device),
+                 m_deadline(device.io_deadline()),
+                 m_locked(false)
+            {
+               int lock_error = m_device.lock_bus_until(m_deadline);
+               m_locked = !lock_error;
+               error = (error ? error : lock_error);
+            }
+
+            ~io_lock(void)
+            {
+               if (m_locked)
+               {
+                  m_device.unlock_bus();
+               }
+            }
+
+            uint64_t deadline(void)
+            {
+               return m_deadline;
+            }
+
+            // ETIMEDOUT once the deadline has passed, for multi-step transfers.
+            int check(void)
+            {
+               return (((m_deadline != 0) && (io_begin() >= m_deadline)) ? ETIMEDOUT : 0);
+            }
+
+         private:
+
+            tuner_devnode_device &m_device;
+            uint64_t m_deadline;
+            bool m_locked;
+      };
+
+      // Called with the bus held when another device has used it since this one.
+      virtual void select_device(void) {}
+
+      uint64_t io_deadline(void)
+      {
+         return ((m_timeout_ms != 0) ? (io_begin() + ((uint64_t)m_timeout_ms * 1000)) : 0);
+      }
+
+      int lock_bus_until(uint64_t deadline);
+
+      int wait_ready(short events, uint64_t deadline);
+
       int m_devnode_fd;
+      tuner_bus *m_bus;
+      tuner_bus_priority m_priority;
+      uint32_t m_timeout_ms;
+      bool m_nonblocking;
 
 };
 
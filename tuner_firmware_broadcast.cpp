@@ -0,0 +1,112 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/errno.h>
+#include <string.h>
+#include "tuner_firmware_broadcast.h"
+
+tuner_firmware_broadcast::tuner_firmware_broadcast(tuner_firmware &fw)
+   : m_fw(fw),
+     m_callback(NULL),
+     m_context(NULL)
+{
+   pthread_mutex_init(&m_lock, NULL);
+}
+
+tuner_firmware_broadcast::~tuner_firmware_broadcast(void)
+{
+   pthread_mutex_destroy(&m_lock);
+}
+
+int tuner_firmware_broadcast::add_target(tuner_firmware_target &target)
+{
+   target_entry entry;
+   entry.target = &target;
+   entry.broadcast = this;
+   entry.index = m_targets.size();
+   entry.error = 0;
+   try
+   {
+      m_targets.push_back(entry);
+   }
+   catch (...)
+   {
+      return ENOMEM;
+   }
+   return 0;
+}
+
+void *tuner_firmware_broadcast::worker(void *arg)
+{
+   target_entry *entry = static_cast<target_entry*>(arg);
+   tuner_firmware_broadcast *broadcast = entry->broadcast;
+   entry->error = entry->target->load_firmware(broadcast->m_fw);
+   if (broadcast->m_callback != NULL)
+   {
+      pthread_mutex_lock(&broadcast->m_lock);
+      broadcast->m_callback(*entry->target, entry->index, entry->error, broadcast->m_context);
+      pthread_mutex_unlock(&broadcast->m_lock);
+   }
+   return NULL;
+}
+
+int tuner_firmware_broadcast::run(tuner_firmware_callback callback, void *context)
+{
+   m_callback = callback;
+   m_context = context;
+   std::vector<pthread_t> threads(m_targets.size());
+   std::vector<bool> started(m_targets.size(), false);
+   for (size_t i = 0; i < m_targets.size(); ++i)
+   {
+      m_targets[i].error = 0;
+      int error = pthread_create(&threads[i], NULL, worker, &m_targets[i]);
+      if (error)
+      {
+         LIBTUNERERR << "Unable to start firmware upload thread: " << strerror(error) << std::endl;
+         // Fall back to uploading from this thread
+         worker(&m_targets[i]);
+      }
+      else
+      {
+         started[i] = true;
+      }
+   }
+   int error = 0;
+   for (size_t i = 0; i < m_targets.size(); ++i)
+   {
+      if (started[i])
+      {
+         pthread_join(threads[i], NULL);
+      }
+      error = (error ? error : m_targets[i].error);
+   }
+   if (!error)
+   {
+      m_fw.update();
+   }
+   return error;
+}
@@ -0,0 +1,102 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_FIRMWARE_BROADCAST_H__
+#define __TUNER_FIRMWARE_BROADCAST_H__
+
+#include <pthread.h>
+#include <vector>
+#include "tuner_firmware.h"
+
+/*
+ * Implemented by drivers that can upload a firmware image opened by the
+ * caller.  Implementations must not call tuner_firmware::update(); the
+ * caller does that once the image is known to be loaded everywhere.
+ */
+class tuner_firmware_target
+{
+   public:
+
+      virtual ~tuner_firmware_target(void) {}
+
+      virtual int load_firmware(tuner_firmware &fw) = 0;
+};
+
+typedef void (*tuner_firmware_callback)(tuner_firmware_target &target, size_t index, int error, void *context);
+
+/*
+ * Uploads one firmware image to several chips of the same type at once, one
+ * thread per target.  Targets on the same physical bus should share a
+ * tuner_bus; they are then serialized by it.
+ */
+class tuner_firmware_broadcast
+{
+   public:
+
+      tuner_firmware_broadcast(tuner_firmware &fw);
+
+      virtual ~tuner_firmware_broadcast(void);
+
+      int add_target(tuner_firmware_target &target);
+
+      /*
+       * Blocks until every target has finished.  The callback, if any, is
+       * run on the uploading thread as each target completes, serialized
+       * with the others.  Returns the first error by target order.
+       */
+      int run(tuner_firmware_callback callback = NULL, void *context = NULL);
+
+      size_t num_targets(void)
+      {
+         return m_targets.size();
+      }
+
+      int error(size_t index)
+      {
+         return m_targets[index].error;
+      }
+
+   private:
+
+      struct target_entry
+      {
+         tuner_firmware_target *target;
+         tuner_firmware_broadcast *broadcast;
+         size_t index;
+         int error;
+      };
+
+      static void *worker(void *arg);
+
+      tuner_firmware &m_fw;
+      std::vector<target_entry> m_targets;
+      pthread_mutex_t m_lock;
+      tuner_firmware_callback m_callback;
+      void *m_context;
+};
+
+#endif
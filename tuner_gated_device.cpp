@@ -0,0 +1,157 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include "tuner_gated_device.h"
+
+tuner_gated_device::tuner_gated_device(tuner_config &config, tuner_device &device, tuner_gate &gate)
+   : tuner_device(config),
+     m_device(device),
+     m_gate(gate),
+     m_depth(0),
+     m_open(false)
+{
+   pthread_mutexattr_t attr;
+   pthread_mutexattr_init(&attr);
+   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+   pthread_mutex_init(&m_lock, &attr);
+   pthread_mutexattr_destroy(&attr);
+}
+
+tuner_gated_device::~tuner_gated_device(void)
+{
+   if (m_open)
+   {
+      m_gate.gate_close();
+   }
+   pthread_mutex_destroy(&m_lock);
+}
+
+// The bus is taken before the gate lock, in the same order as a demod
+// driver holding the bus while it calls through this device.
+void tuner_gated_device::hold(void)
+{
+   m_device.lock_bus();
+   pthread_mutex_lock(&m_lock);
+   ++m_depth;
+}
+
+int tuner_gated_device::release(void)
+{
+   int error = 0;
+   if ((--m_depth == 0) && m_open)
+   {
+      error = m_gate.gate_close();
+      m_open = false;
+   }
+   pthread_mutex_unlock(&m_lock);
+   m_device.unlock_bus();
+   return error;
+}
+
+int tuner_gated_device::begin_burst(void)
+{
+   hold();
+   if (!m_open)
+   {
+      int error = m_gate.gate_open();
+      if (error)
+      {
+         release();
+         return error;
+      }
+      m_open = true;
+   }
+   return 0;
+}
+
+int tuner_gated_device::end_burst(void)
+{
+   return release();
+}
+
+int tuner_gated_device::write(const uint8_t *buffer, size_t size, size_t &written)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.write(buffer, size, written));
+}
+
+int tuner_gated_device::read(uint8_t *buffer, size_t size, size_t &read)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.read(buffer, size, read));
+}
+
+int tuner_gated_device::write(const struct iovec *iov, size_t iovcnt)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.write(iov, iovcnt));
+}
+
+int tuner_gated_device::write_array(const uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.write_array(buffer, elem_size, total_size));
+}
+
+int tuner_gated_device::read_array(uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.read_array(buffer, elem_size, total_size));
+}
+
+int tuner_gated_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.transact(write_buffer, write_size, read_buffer, read_size));
+}
+
+int tuner_gated_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.submit(ops, num_ops));
+}
+
+int tuner_gated_device::update_bits(uint8_t reg, uint8_t mask, uint8_t value)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.update_bits(reg, mask, value));
+}
+
+int tuner_gated_device::update_bits16(uint8_t reg, uint16_t mask, uint16_t value)
+{
+   int error = 0;
+   burst b(*this, error);
+   return (error ? error : m_device.update_bits16(reg, mask, value));
+}
@@ -0,0 +1,146 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_GATED_DEVICE_H__
+#define __TUNER_GATED_DEVICE_H__
+
+#include <pthread.h>
+#include "tuner_device.h"
+#include "tuner_gate.h"
+
+/*
+ * Wraps the device of a tuner that sits behind another chip's I2C gate.
+ * The gate is opened by the first operation and closed when the outermost
+ * bus lock or burst ends, so a driver that holds the bus across a sequence
+ * (tuner_device::bus_lock) opens the gate once for it.  Operations made
+ * without either open and close the gate around themselves.  Bursts and
+ * bus locks nest, and the gate state is guarded by its own lock, so this
+ * is safe without an underlying bus.
+ */
+class tuner_gated_device
+   : public tuner_device
+{
+   public:
+
+      tuner_gated_device(tuner_config &config, tuner_device &device, tuner_gate &gate);
+
+      virtual ~tuner_gated_device(void);
+
+      virtual int write(const uint8_t *buffer, size_t size, size_t &written);
+
+      virtual int read(uint8_t *buffer, size_t size, size_t &read);
+
+      virtual int write(const struct iovec *iov, size_t iovcnt);
+
+      virtual int write_array(const uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int read_array(uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
+
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      virtual int update_bits(uint8_t reg, uint8_t mask, uint8_t value);
+
+      virtual int update_bits16(uint8_t reg, uint16_t mask, uint16_t value);
+
+      virtual size_t max_transfer_size(void)
+      {
+         return m_device.max_transfer_size();
+      }
+
+      virtual void set_write_combining(bool enable)
+      {
+         tuner_device::set_write_combining(enable);
+         m_device.set_write_combining(enable);
+      }
+
+      virtual int set_bus_speed(uint32_t hz)
+      {
+         return m_device.set_bus_speed(hz);
+      }
+
+      virtual int get_bus_speed(uint32_t &hz)
+      {
+         return m_device.get_bus_speed(hz);
+      }
+
+      virtual void lock_bus(void)
+      {
+         hold();
+      }
+
+      virtual void unlock_bus(void)
+      {
+         release();
+      }
+
+      int begin_burst(void);
+
+      int end_burst(void);
+
+      class burst
+      {
+         public:
+
+            burst(tuner_gated_device &device, int &error)
+               : m_device(device),
+                 m_started(false)
+            {
+               int burst_error = m_device.begin_burst();
+               m_started = !burst_error;
+               error = (error ? error : burst_error);
+            }
+
+            ~burst(void)
+            {
+               if (m_started)
+               {
+                  m_device.end_burst();
+               }
+            }
+
+         private:
+
+            tuner_gated_device &m_device;
+            bool m_started;
+      };
+
+   private:
+
+      void hold(void);
+
+      int release(void);
+
+      tuner_device &m_device;
+      tuner_gate &m_gate;
+      pthread_mutex_t m_lock;
+      unsigned int m_depth;
+      bool m_open;
+};
+
+#endif
@@ -26,6 +26,10 @@
  */
 
 #include <sys/types.h>
+#include <sys/sysctl.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string>
 #include <dev/iicbus/iic.h>
 #include "tuner_iic_device.h"
 
@@ -36,9 +40,128 @@ tuner_iic_device::tuner_iic_device(tuner_config &config, const char *devnode, ui
    if (!error) error = ioctl(m_devnode_fd, I2CSADDR, &m_addr);
 }
 
+tuner_iic_device::tuner_iic_device(tuner_config &config, tuner_bus &bus, uint8_t addr, int &error)
+   : tuner_devnode_device(config, bus, error),
+     m_addr(addr << 1)
+{}
+
+void tuner_iic_device::select_device(void)
+{
+   ioctl(m_devnode_fd, I2CSADDR, &m_addr);
+}
+
+/*
+ * The clock is a tunable of the iicbus instance the iic node hangs off,
+ * applied when the controller is reset.
+ */
+int tuner_iic_device::frequency_oid(std::string &oid)
+{
+   char devname[32];
+   if (fdevname_r(m_devnode_fd, devname, sizeof(devname)) == NULL)
+   {
+      return ENODEV;
+   }
+   std::string parent_oid = "dev.iic.";
+   parent_oid += (devname + strcspn(devname, "0123456789"));
+   parent_oid += ".%parent";
+   char parent[32];
+   size_t len = sizeof(parent);
+   if (sysctlbyname(parent_oid.c_str(), parent, &len, NULL, 0) < 0)
+   {
+      return errno;
+   }
+   parent[sizeof(parent) - 1] = '\0';
+   oid = "dev.iicbus.";
+   oid += (parent + strcspn(parent, "0123456789"));
+   oid += ".frequency";
+   return 0;
+}
+
+int tuner_iic_device::set_bus_speed(uint32_t hz)
+{
+   bus_lock lock(*this);
+   std::string oid;
+   int error = frequency_oid(oid);
+   if (error)
+   {
+      return error;
+   }
+   u_int frequency = hz;
+   if (sysctlbyname(oid.c_str(), NULL, NULL, &frequency, sizeof(frequency)) < 0)
+   {
+      LIBTUNERERR << "Unable to set " << oid << ": " << strerror(errno) << std::endl;
+      return errno;
+   }
+   struct iiccmd cmd;
+   memset(&cmd, 0, sizeof(cmd));
+   if (ioctl(m_devnode_fd, I2CRSTCARD, &cmd) < 0)
+   {
+      return errno;
+   }
+   ioctl(m_devnode_fd, I2CSADDR, &m_addr);
+   return 0;
+}
+
+int tuner_iic_device::get_bus_speed(uint32_t &hz)
+{
+   std::string oid;
+   int error = frequency_oid(oid);
+   if (error)
+   {
+      return error;
+   }
+   u_int frequency = 0;
+   size_t len = sizeof(frequency);
+   if (sysctlbyname(oid.c_str(), &frequency, &len, NULL, 0) < 0)
+   {
+      return errno;
+   }
+   hz = frequency;
+   return 0;
+}
+
+int tuner_iic_device::write(const struct iovec *iov, size_t iovcnt)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   if (error)
+   {
+      return error;
+   }
+   struct iiccmd cmd;
+   cmd.slave = m_addr;
+   cmd.count = 0;
+   cmd.last = 0;
+   cmd.buf = NULL;
+   size_t written = 0;
+   uint64_t start = io_begin();
+   error = ioctl(m_devnode_fd, I2CSTART, &cmd);
+   for (size_t i = 0; !error && (i < iovcnt); ++i)
+   {
+      cmd.count = (int)iov[i].iov_len;
+      cmd.buf = (char*)iov[i].iov_base;
+      cmd.last = ((i + 1) == iovcnt);
+      error = lock.check();
+      error = (error ? error : ioctl(m_devnode_fd, I2CWRITE, &cmd));
+      written += iov[i].iov_len;
+   }
+   ioctl(m_devnode_fd, I2CSTOP);
+   io_end(TUNER_STAT_WRITE, start, error, written, 0);
+   return error;
+}
+
 int tuner_iic_device::write_array(const uint8_t *buffer, size_t elem_size, size_t total_size)
 {
+   if (m_write_combining && (elem_size > 1))
+   {
+      return write_combined(buffer, elem_size, total_size);
+   }
    int error = 0;
+   io_lock lock(*this, error);
+   if (error)
+   {
+      return error;
+   }
    if ((total_size % elem_size) != 0)
    {
       return EINVAL;
@@ -49,22 +172,30 @@ int tuner_iic_device::write_array(const uint8_t *buffer, size_t elem_size, size_
    cmd.count = 0;
    cmd.last = 0;
    cmd.buf = NULL;
+   uint64_t start = io_begin();
    error = ioctl(m_devnode_fd, I2CSTART, &cmd);
    cmd.count = (int)elem_size;
    for (size_t i = 0; !error && i < total_size; i += elem_size)
    {
       cmd.buf = (char*)buffer + i;
       if ((i + elem_size) >= total_size) cmd.last = 1;
-      error = ioctl(m_devnode_fd, I2CWRITE, &cmd);
+      error = lock.check();
+      error = (error ? error : ioctl(m_devnode_fd, I2CWRITE, &cmd));
       if (!error && !cmd.last) error = ioctl(m_devnode_fd, I2CRPTSTART, &cmd);
    }
    ioctl(m_devnode_fd, I2CSTOP);
+   io_end(TUNER_STAT_WRITE, start, error, total_size, 0);
    return error;
 }
 
 int tuner_iic_device::read_array(uint8_t *buffer, size_t elem_size, size_t total_size)
 {
    int error = 0;
+   io_lock lock(*this, error);
+   if (error)
+   {
+      return error;
+   }
    if ((total_size % elem_size) != 0)
    {
       return EINVAL;
@@ -75,41 +206,118 @@ int tuner_iic_device::read_array(uint8_t *buffer, size_t elem_size, size_t total
    cmd.count = 0;
    cmd.last = 0;
    cmd.buf = NULL;
+   uint64_t start = io_begin();
    error = ioctl(m_devnode_fd, I2CSTART, &cmd);
    cmd.count = (int)elem_size;
    for (size_t i = 0; !error && i < total_size; i += elem_size)
    {
       cmd.buf = (char*)buffer + i;
       if ((i + elem_size) >= total_size) cmd.last = 1;
-      error = ioctl(m_devnode_fd, I2CREAD, &cmd);
+      error = lock.check();
+      error = (error ? error : ioctl(m_devnode_fd, I2CREAD, &cmd));
       if (!error && !cmd.last) error = ioctl(m_devnode_fd, I2CRPTSTART, &cmd);
    }
    ioctl(m_devnode_fd, I2CSTOP);
+   io_end(TUNER_STAT_READ, start, error, 0, total_size);
    return error;
 
 }
 
 int tuner_iic_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
 {
+   int error = 0;
+   io_lock lock(*this, error);
+   if (error)
+   {
+      return error;
+   }
    struct iiccmd cmd;
    cmd.slave = m_addr;
    cmd.count = 0;
    cmd.last = 0;
    cmd.buf = NULL;
 
-   int error = ioctl(m_devnode_fd, I2CSTART, &cmd);
+   uint64_t start = io_begin();
+   error = ioctl(m_devnode_fd, I2CSTART, &cmd);
    cmd.count = (int)write_size;
    cmd.buf = (char*)write_buffer;
    cmd.last = 1;
    error = (error ? error : ioctl(m_devnode_fd, I2CWRITE, &cmd));
    cmd.slave |= 1;
+   error = (error ? error : lock.check());
    error = (error ? error : ioctl(m_devnode_fd, I2CRPTSTART, &cmd));
    cmd.count = (int)read_size;
    cmd.buf = (char*)read_buffer;
    cmd.last = 1;
    error = (error ? error : ioctl(m_devnode_fd, I2CREAD, &cmd));
    ioctl(m_devnode_fd, I2CSTOP);
+   io_end(TUNER_STAT_TRANSACT, start, error, write_size, read_size);
 
    return error;
 }
 
+
+int tuner_iic_device::transfer(unsigned long request, bool &started, uint8_t *buffer, size_t size)
+{
+   struct iiccmd cmd;
+   cmd.slave = m_addr;
+   if (request == I2CREAD)
+   {
+      cmd.slave |= 1;
+   }
+   cmd.count = 0;
+   cmd.last = 0;
+   cmd.buf = NULL;
+   int error = ioctl(m_devnode_fd, (started ? I2CRPTSTART : I2CSTART), &cmd);
+   started = true;
+   cmd.count = (int)size;
+   cmd.buf = (char*)buffer;
+   cmd.last = 1;
+   return (error ? error : ioctl(m_devnode_fd, request, &cmd));
+}
+
+int tuner_iic_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   if (error)
+   {
+      return error;
+   }
+   bool started = false;
+   size_t written = 0, read = 0;
+   uint64_t start = io_begin();
+   for (size_t i = 0; !error && (i < num_ops); ++i)
+   {
+      if ((error = lock.check()))
+      {
+         break;
+      }
+      switch (ops[i].type)
+      {
+         case TUNER_OP_WRITE:
+            error = transfer(I2CWRITE, started, const_cast<uint8_t*>(ops[i].write_buffer), ops[i].write_size);
+            written += ops[i].write_size;
+            break;
+         case TUNER_OP_READ:
+            error = transfer(I2CREAD, started, ops[i].read_buffer, ops[i].read_size);
+            read += ops[i].read_size;
+            break;
+         case TUNER_OP_TRANSACT:
+            error = transfer(I2CWRITE, started, const_cast<uint8_t*>(ops[i].write_buffer), ops[i].write_size);
+            error = (error ? error : transfer(I2CREAD, started, ops[i].read_buffer, ops[i].read_size));
+            written += ops[i].write_size;
+            read += ops[i].read_size;
+            break;
+         default:
+            error = EINVAL;
+            break;
+      }
+   }
+   if (started)
+   {
+      ioctl(m_devnode_fd, I2CSTOP);
+   }
+   io_end(TUNER_STAT_SUBMIT, start, error, written, read);
+   return error;
+}
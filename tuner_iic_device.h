@@ -30,6 +30,11 @@
 
 #include "tuner_devnode_device.h"
 
+/*
+ * iic(4) has no transfer timeout of its own, so a deadline set with
+ * set_timeout() is checked between the steps of each transfer and the
+ * transfer is stopped once it has passed.
+ */
 class tuner_iic_device
    : public tuner_devnode_device
 {
@@ -38,14 +43,36 @@ class tuner_iic_device
 
       tuner_iic_device(tuner_config &config, const char *devnode, uint8_t addr, int &error);
 
+      tuner_iic_device(tuner_config &config, tuner_bus &bus, uint8_t addr, int &error);
+
+      virtual int write(const struct iovec *iov, size_t iovcnt);
+
       virtual int write_array(const uint8_t *buffer, size_t elem_size, size_t total_size);
 
       virtual int read_array(uint8_t *buffer, size_t elem_size, size_t total_size);
 
       virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
 
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      virtual size_t max_transfer_size(void)
+      {
+         // Conservative; matches the iic(4) read/write buffer size
+         return 1024;
+      }
+
+      virtual int set_bus_speed(uint32_t hz);
+
+      virtual int get_bus_speed(uint32_t &hz);
+
    protected:
 
+      virtual void select_device(void);
+
+      int frequency_oid(std::string &oid);
+
+      int transfer(unsigned long request, bool &started, uint8_t *buffer, size_t size);
+
       uint8_t m_addr;
 };
 
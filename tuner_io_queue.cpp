@@ -0,0 +1,184 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/errno.h>
+#include "tuner_io_queue.h"
+
+tuner_io_queue::tuner_io_queue(int &error)
+   : m_head(NULL),
+     m_tail(NULL),
+     m_pending(0),
+     m_running(false),
+     m_stopping(false)
+{
+   pthread_mutex_init(&m_lock, NULL);
+   pthread_cond_init(&m_submitted, NULL);
+   pthread_cond_init(&m_completed, NULL);
+   if (error)
+   {
+      return;
+   }
+   if ((error = pthread_create(&m_thread, NULL, worker, this)))
+   {
+      LIBTUNERERR << "Unable to create I/O queue thread: " << strerror(error) << std::endl;
+      return;
+   }
+   m_running = true;
+}
+
+tuner_io_queue::~tuner_io_queue(void)
+{
+   if (m_running && pthread_equal(pthread_self(), m_thread))
+   {
+      LIBTUNERERR << "I/O queue destroyed from its own callback" << std::endl;
+   }
+   else if (m_running)
+   {
+      drain();
+      pthread_mutex_lock(&m_lock);
+      m_stopping = true;
+      pthread_cond_signal(&m_submitted);
+      pthread_mutex_unlock(&m_lock);
+      pthread_join(m_thread, NULL);
+   }
+   pthread_cond_destroy(&m_completed);
+   pthread_cond_destroy(&m_submitted);
+   pthread_mutex_destroy(&m_lock);
+}
+
+int tuner_io_queue::submit(tuner_io_request &request)
+{
+   pthread_mutex_lock(&m_lock);
+   if (!m_running || m_stopping || !request.m_complete)
+   {
+      pthread_mutex_unlock(&m_lock);
+      return EINVAL;
+   }
+   request.m_error = 0;
+   request.m_complete = false;
+   request.m_next = NULL;
+   if (m_tail == NULL)
+   {
+      m_head = &request;
+   }
+   else
+   {
+      m_tail->m_next = &request;
+   }
+   m_tail = &request;
+   ++m_pending;
+   pthread_cond_signal(&m_submitted);
+   pthread_mutex_unlock(&m_lock);
+   return 0;
+}
+
+int tuner_io_queue::wait(tuner_io_request &request)
+{
+   if (m_running && pthread_equal(pthread_self(), m_thread))
+   {
+      return EDEADLK;
+   }
+   pthread_mutex_lock(&m_lock);
+   while (!request.m_complete || request.m_in_callback)
+   {
+      pthread_cond_wait(&m_completed, &m_lock);
+   }
+   int error = request.m_error;
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
+
+int tuner_io_queue::drain(void)
+{
+   if (m_running && pthread_equal(pthread_self(), m_thread))
+   {
+      return EDEADLK;
+   }
+   pthread_mutex_lock(&m_lock);
+   while (m_pending > 0)
+   {
+      pthread_cond_wait(&m_completed, &m_lock);
+   }
+   pthread_mutex_unlock(&m_lock);
+   return 0;
+}
+
+void *tuner_io_queue::worker(void *arg)
+{
+   reinterpret_cast<tuner_io_queue*>(arg)->run();
+   return NULL;
+}
+
+void tuner_io_queue::run(void)
+{
+   pthread_mutex_lock(&m_lock);
+   for (;;)
+   {
+      while ((m_head == NULL) && !m_stopping)
+      {
+         pthread_cond_wait(&m_submitted, &m_lock);
+      }
+      if (m_head == NULL)
+      {
+         break;
+      }
+      complete_next();
+   }
+   pthread_mutex_unlock(&m_lock);
+}
+
+/*
+ * Runs the request at the head of the queue.  Called on the worker thread
+ * with the lock held; the lock is dropped around the transfer and callback.
+ */
+void tuner_io_queue::complete_next(void)
+{
+   tuner_io_request *request = m_head;
+   m_head = request->m_next;
+   if (m_head == NULL)
+   {
+      m_tail = NULL;
+   }
+   pthread_mutex_unlock(&m_lock);
+
+   int error = request->m_device.submit(request->m_ops, request->m_num_ops);
+
+   pthread_mutex_lock(&m_lock);
+   request->m_error = error;
+   request->m_complete = true;
+   tuner_io_callback callback = request->m_callback;
+   if (callback != NULL)
+   {
+      request->m_in_callback = true;
+      pthread_mutex_unlock(&m_lock);
+      callback(*request, error, request->m_context);
+      pthread_mutex_lock(&m_lock);
+      request->m_in_callback = false;
+   }
+   --m_pending;
+   pthread_cond_broadcast(&m_completed);
+}
@@ -0,0 +1,126 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_IO_QUEUE_H__
+#define __TUNER_IO_QUEUE_H__
+
+#include <pthread.h>
+#include "tuner_device.h"
+
+class tuner_io_request;
+
+typedef void (*tuner_io_callback)(tuner_io_request &request, int error, void *context);
+
+/*
+ * A batch of operations queued against one device.  The request and the
+ * operations it points to must stay valid until it completes.  The request
+ * is already complete when its callback runs, so the callback may submit it
+ * again, but must not destroy it.
+ */
+class tuner_io_request
+{
+   public:
+
+      tuner_io_request(
+         tuner_device &device,
+         const tuner_op *ops,
+         size_t num_ops,
+         tuner_io_callback callback = NULL,
+         void *context = NULL)
+         : m_device(device),
+           m_ops(ops),
+           m_num_ops(num_ops),
+           m_callback(callback),
+           m_context(context),
+           m_error(0),
+           m_complete(true),
+           m_in_callback(false),
+           m_next(NULL)
+      {}
+
+      int error(void)
+      {
+         return m_error;
+      }
+
+   private:
+
+      friend class tuner_io_queue;
+
+      tuner_device &m_device;
+      const tuner_op *m_ops;
+      size_t m_num_ops;
+      tuner_io_callback m_callback;
+      void *m_context;
+      int m_error;
+      bool m_complete;
+      bool m_in_callback;
+      tuner_io_request *m_next;
+};
+
+/*
+ * Runs submitted requests in order on a worker thread.  Use one queue per
+ * physical bus.  Completion callbacks run on the worker thread, so nothing
+ * queued behind them can complete until they return: wait() and drain()
+ * called from a callback fail with EDEADLK instead of blocking, and a
+ * callback may submit requests but must not wait for them.  The queue must
+ * not be destroyed from one of its callbacks.
+ */
+class tuner_io_queue
+{
+   public:
+
+      tuner_io_queue(int &error);
+
+      virtual ~tuner_io_queue(void);
+
+      int submit(tuner_io_request &request);
+
+      int wait(tuner_io_request &request);
+
+      int drain(void);
+
+   private:
+
+      static void *worker(void *arg);
+
+      void run(void);
+
+      void complete_next(void);
+
+      pthread_t m_thread;
+      pthread_mutex_t m_lock;
+      pthread_cond_t m_submitted;
+      pthread_cond_t m_completed;
+      tuner_io_request *m_head;
+      tuner_io_request *m_tail;
+      size_t m_pending;
+      bool m_running;
+      bool m_stopping;
+};
+
+#endif
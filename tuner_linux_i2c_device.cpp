@@ -0,0 +1,269 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <string.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "tuner_linux_i2c_device.h"
+
+// The i2c core's adapter timeout when the driver doesn't set one (HZ), in
+// I2C_TIMEOUT's units of 10 ms.
+#define I2C_DEFAULT_TIMEOUT 100
+
+tuner_linux_i2c_device::tuner_linux_i2c_device(tuner_config &config, const char *devnode, uint8_t addr, int &error)
+   : tuner_devnode_device(config, devnode, error),
+     m_addr(addr),
+     m_nostart(false)
+{
+   if (!error && (ioctl(m_devnode_fd, I2C_SLAVE, (unsigned long)m_addr) < 0))
+   {
+      LIBTUNERERR << "Unable to set I2C slave address " << std::hex << (int)m_addr << std::dec << ": " << strerror(errno) << std::endl;
+      error = errno;
+   }
+   probe_functionality(error);
+}
+
+tuner_linux_i2c_device::tuner_linux_i2c_device(tuner_config &config, tuner_bus &bus, uint8_t addr, int &error)
+   : tuner_devnode_device(config, bus, error),
+     m_addr(addr),
+     m_nostart(false)
+{
+   probe_functionality(error);
+}
+
+void tuner_linux_i2c_device::probe_functionality(int &error)
+{
+   unsigned long funcs = 0;
+   if (!error && (ioctl(m_devnode_fd, I2C_FUNCS, &funcs) == 0))
+   {
+      m_nostart = ((funcs & I2C_FUNC_NOSTART) != 0);
+   }
+}
+
+void tuner_linux_i2c_device::select_device(void)
+{
+   ioctl(m_devnode_fd, I2C_SLAVE, (unsigned long)m_addr);
+   ioctl(m_devnode_fd, I2C_TIMEOUT, adapter_timeout());
+}
+
+unsigned long tuner_linux_i2c_device::adapter_timeout(void)
+{
+   return ((m_timeout_ms != 0) ? ((m_timeout_ms + 9) / 10) : I2C_DEFAULT_TIMEOUT);
+}
+
+int tuner_linux_i2c_device::set_timeout(uint32_t timeout_ms)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   tuner_devnode_device::set_timeout(timeout_ms);
+   if (!error && (ioctl(m_devnode_fd, I2C_TIMEOUT, adapter_timeout()) < 0))
+   {
+      error = errno;
+   }
+   return error;
+}
+
+int tuner_linux_i2c_device::write(const struct iovec *iov, size_t iovcnt)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   if (error)
+   {
+      return error;
+   }
+   // i2c-dev has no writev, so without I2C_M_NOSTART support the pieces
+   // must be gathered into one message to keep them in one transfer.
+   if (!m_nostart || (iovcnt > I2C_RDWR_IOCTL_MAX_MSGS))
+   {
+      return tuner_device::write(iov, iovcnt);
+   }
+   struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+   for (size_t i = 0; i < iovcnt; ++i)
+   {
+      if (iov[i].iov_len > 0xFFFF)
+      {
+         return EINVAL;
+      }
+      msgs[i].addr = m_addr;
+      msgs[i].flags = ((i == 0) ? 0 : I2C_M_NOSTART);
+      msgs[i].len = (uint16_t)iov[i].iov_len;
+      msgs[i].buf = (uint8_t*)iov[i].iov_base;
+   }
+   return rdwr(TUNER_STAT_WRITE, msgs, iovcnt);
+}
+
+int tuner_linux_i2c_device::rdwr(tuner_stat_op op, struct i2c_msg *msgs, size_t num_msgs)
+{
+   struct i2c_rdwr_ioctl_data data;
+   data.msgs = msgs;
+   data.nmsgs = (uint32_t)num_msgs;
+   size_t written = 0, read = 0;
+   for (size_t i = 0; i < num_msgs; ++i)
+   {
+      if (msgs[i].flags & I2C_M_RD)
+      {
+         read += msgs[i].len;
+      }
+      else
+      {
+         written += msgs[i].len;
+      }
+   }
+   uint64_t start = io_begin();
+   int error = 0;
+   if (ioctl(m_devnode_fd, I2C_RDWR, &data) < 0)
+   {
+      error = errno;
+   }
+   io_end(op, start, error, written, read);
+   return error;
+}
+
+int tuner_linux_i2c_device::transfer_array(uint8_t *buffer, size_t elem_size, size_t total_size, uint16_t flags)
+{
+   if ((elem_size == 0) || (elem_size > 0xFFFF) || ((total_size % elem_size) != 0))
+   {
+      return EINVAL;
+   }
+   int error = 0;
+   io_lock lock(*this, error);
+   struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+   size_t i = 0;
+   while (!error && (i < total_size))
+   {
+      size_t num_msgs = 0;
+      for (; (num_msgs < I2C_RDWR_IOCTL_MAX_MSGS) && (i < total_size); ++num_msgs, i += elem_size)
+      {
+         msgs[num_msgs].addr = m_addr;
+         msgs[num_msgs].flags = flags;
+         msgs[num_msgs].len = (uint16_t)elem_size;
+         msgs[num_msgs].buf = buffer + i;
+      }
+      error = lock.check();
+      error = (error ? error : rdwr(((flags & I2C_M_RD) ? TUNER_STAT_READ : TUNER_STAT_WRITE), msgs, num_msgs));
+   }
+   return error;
+}
+
+int tuner_linux_i2c_device::write_array(const uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   if (m_write_combining && (elem_size > 1))
+   {
+      return write_combined(buffer, elem_size, total_size);
+   }
+   return transfer_array(const_cast<uint8_t*>(buffer), elem_size, total_size, 0);
+}
+
+int tuner_linux_i2c_device::read_array(uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   return transfer_array(buffer, elem_size, total_size, I2C_M_RD);
+}
+
+int tuner_linux_i2c_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
+{
+   if ((write_size > 0xFFFF) || (read_size > 0xFFFF))
+   {
+      return EINVAL;
+   }
+   int error = 0;
+   io_lock lock(*this, error);
+   if (error)
+   {
+      return error;
+   }
+   struct i2c_msg msgs[2];
+   msgs[0].addr = m_addr;
+   msgs[0].flags = 0;
+   msgs[0].len = (uint16_t)write_size;
+   msgs[0].buf = const_cast<uint8_t*>(write_buffer);
+   msgs[1].addr = m_addr;
+   msgs[1].flags = I2C_M_RD;
+   msgs[1].len = (uint16_t)read_size;
+   msgs[1].buf = read_buffer;
+   return rdwr(TUNER_STAT_TRANSACT, msgs, 2);
+}
+
+int tuner_linux_i2c_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   int error = 0;
+   io_lock lock(*this, error);
+   struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+   size_t num_msgs = 0;
+   for (size_t i = 0; !error && (i < num_ops); ++i)
+   {
+      size_t op_msgs = ((ops[i].type == TUNER_OP_TRANSACT) ? 2 : 1);
+      if ((num_msgs + op_msgs) > I2C_RDWR_IOCTL_MAX_MSGS)
+      {
+         error = lock.check();
+         error = (error ? error : rdwr(TUNER_STAT_SUBMIT, msgs, num_msgs));
+         num_msgs = 0;
+      }
+      if (error)
+      {
+         break;
+      }
+      if ((ops[i].write_size > 0xFFFF) || (ops[i].read_size > 0xFFFF))
+      {
+         error = EINVAL;
+         break;
+      }
+      switch (ops[i].type)
+      {
+         case TUNER_OP_WRITE:
+         case TUNER_OP_TRANSACT:
+            msgs[num_msgs].addr = m_addr;
+            msgs[num_msgs].flags = 0;
+            msgs[num_msgs].len = (uint16_t)ops[i].write_size;
+            msgs[num_msgs].buf = const_cast<uint8_t*>(ops[i].write_buffer);
+            ++num_msgs;
+            if (ops[i].type == TUNER_OP_WRITE)
+            {
+               break;
+            }
+            // fall through
+         case TUNER_OP_READ:
+            msgs[num_msgs].addr = m_addr;
+            msgs[num_msgs].flags = I2C_M_RD;
+            msgs[num_msgs].len = (uint16_t)ops[i].read_size;
+            msgs[num_msgs].buf = ops[i].read_buffer;
+            ++num_msgs;
+            break;
+         default:
+            error = EINVAL;
+            break;
+      }
+   }
+   if (!error && (num_msgs > 0))
+   {
+      error = lock.check();
+      error = (error ? error : rdwr(TUNER_STAT_SUBMIT, msgs, num_msgs));
+   }
+   return error;
+}
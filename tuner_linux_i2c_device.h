@@ -0,0 +1,86 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_LINUX_I2C_DEVICE_H__
+#define __TUNER_LINUX_I2C_DEVICE_H__
+
+#include "tuner_devnode_device.h"
+
+struct i2c_msg;
+
+class tuner_linux_i2c_device
+   : public tuner_devnode_device
+{
+
+   public:
+
+      tuner_linux_i2c_device(tuner_config &config, const char *devnode, uint8_t addr, int &error);
+
+      tuner_linux_i2c_device(tuner_config &config, tuner_bus &bus, uint8_t addr, int &error);
+
+      virtual int write(const struct iovec *iov, size_t iovcnt);
+
+      virtual int write_array(const uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int read_array(uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
+
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      virtual size_t max_transfer_size(void)
+      {
+         // i2c-dev rejects messages larger than this
+         return 8192;
+      }
+
+      /*
+       * Also sets the adapter's I2C_TIMEOUT, which bounds each I2C_RDWR
+       * transfer in the kernel.  That timeout belongs to the adapter, so it
+       * is set again whenever the bus switches to this device; devices on
+       * the same adapter through separate fds share it.
+       */
+      virtual int set_timeout(uint32_t timeout_ms);
+
+   protected:
+
+      virtual void select_device(void);
+
+      void probe_functionality(int &error);
+
+      unsigned long adapter_timeout(void);
+
+      int rdwr(tuner_stat_op op, struct i2c_msg *msgs, size_t num_msgs);
+
+      int transfer_array(uint8_t *buffer, size_t elem_size, size_t total_size, uint16_t flags);
+
+      uint8_t m_addr;
+      bool m_nostart;
+};
+
+
+#endif
@@ -0,0 +1,254 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/errno.h>
+#include <string.h>
+#include <time.h>
+#include "tuner_record_device.h"
+
+tuner_record_device::tuner_record_device(tuner_config &config, tuner_device &device, const char *filename, int &error)
+   : tuner_device(config),
+     m_device(device),
+     m_stream(NULL),
+     m_flush_each(false)
+{
+   pthread_mutex_init(&m_lock, NULL);
+   if (error)
+   {
+      return;
+   }
+   if ((m_stream = fopen(filename, "w")) == NULL)
+   {
+      LIBTUNERERR << "Unable to open trace file " << filename << ": " << strerror(errno) << std::endl;
+      error = errno;
+      return;
+   }
+   tuner_trace_header header;
+   header.magic = TUNER_TRACE_MAGIC;
+   header.version = TUNER_TRACE_VERSION;
+   if (fwrite(&header, sizeof(header), 1, m_stream) != 1)
+   {
+      error = EIO;
+   }
+}
+
+tuner_record_device::~tuner_record_device(void)
+{
+   if (m_stream != NULL)
+   {
+      fclose(m_stream);
+      m_stream = NULL;
+   }
+   pthread_mutex_destroy(&m_lock);
+}
+
+uint64_t tuner_record_device::now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+void tuner_record_device::record_header(
+   tuner_trace_type type,
+   int error,
+   uint64_t timestamp,
+   size_t write_size,
+   size_t read_size,
+   size_t count)
+{
+   tuner_trace_record rec;
+   memset(&rec, 0, sizeof(rec));
+   rec.type = type;
+   rec.error = error;
+   rec.timestamp_ns = timestamp;
+   rec.write_size = (uint32_t)write_size;
+   rec.read_size = (uint32_t)read_size;
+   rec.count = (uint32_t)count;
+   fwrite(&rec, sizeof(rec), 1, m_stream);
+}
+
+void tuner_record_device::record(
+   tuner_trace_type type,
+   int error,
+   uint64_t timestamp,
+   const uint8_t *write_buffer,
+   size_t write_size,
+   const uint8_t *read_buffer,
+   size_t read_size,
+   size_t count)
+{
+   if (m_stream == NULL)
+   {
+      return;
+   }
+   record_header(type, error, timestamp, write_size, read_size, count);
+   if (write_size > 0)
+   {
+      fwrite(write_buffer, 1, write_size, m_stream);
+   }
+   if (read_size > 0)
+   {
+      fwrite(read_buffer, 1, read_size, m_stream);
+   }
+}
+
+// Pushes each completed record to the file if asked to, so a trace survives a crash.
+void tuner_record_device::record_done(void)
+{
+   if (m_flush_each && (m_stream != NULL))
+   {
+      fflush(m_stream);
+   }
+}
+
+void tuner_record_device::set_flush_each(bool enable)
+{
+   pthread_mutex_lock(&m_lock);
+   m_flush_each = enable;
+   pthread_mutex_unlock(&m_lock);
+}
+
+int tuner_record_device::flush(void)
+{
+   int error = 0;
+   pthread_mutex_lock(&m_lock);
+   if ((m_stream != NULL) && (fflush(m_stream) != 0))
+   {
+      error = errno;
+   }
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
+
+int tuner_record_device::write(const uint8_t *buffer, size_t size, size_t &written)
+{
+   uint64_t timestamp = now();
+   int error = m_device.write(buffer, size, written);
+   pthread_mutex_lock(&m_lock);
+   record(TUNER_TRACE_WRITE, error, timestamp, buffer, (error ? 0 : written), NULL, 0, 1);
+   record_done();
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
+
+int tuner_record_device::read(uint8_t *buffer, size_t size, size_t &read)
+{
+   uint64_t timestamp = now();
+   int error = m_device.read(buffer, size, read);
+   pthread_mutex_lock(&m_lock);
+   record(TUNER_TRACE_READ, error, timestamp, NULL, 0, buffer, (error ? 0 : read), 1);
+   record_done();
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
+
+int tuner_record_device::write(const struct iovec *iov, size_t iovcnt)
+{
+   uint64_t timestamp = now();
+   int error = m_device.write(iov, iovcnt);
+   size_t total = 0;
+   for (size_t i = 0; !error && (i < iovcnt); ++i)
+   {
+      total += iov[i].iov_len;
+   }
+   pthread_mutex_lock(&m_lock);
+   if (m_stream != NULL)
+   {
+      record_header(TUNER_TRACE_WRITE, error, timestamp, total, 0, 1);
+      for (size_t i = 0; !error && (i < iovcnt); ++i)
+      {
+         fwrite(iov[i].iov_base, 1, iov[i].iov_len, m_stream);
+      }
+   }
+   record_done();
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
+
+int tuner_record_device::write_array(const uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   uint64_t timestamp = now();
+   int error = m_device.write_array(buffer, elem_size, total_size);
+   pthread_mutex_lock(&m_lock);
+   record(TUNER_TRACE_WRITE_ARRAY, error, timestamp, buffer, (error ? 0 : total_size), NULL, 0, elem_size);
+   record_done();
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
+
+int tuner_record_device::read_array(uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   uint64_t timestamp = now();
+   int error = m_device.read_array(buffer, elem_size, total_size);
+   pthread_mutex_lock(&m_lock);
+   record(TUNER_TRACE_READ_ARRAY, error, timestamp, NULL, 0, buffer, (error ? 0 : total_size), elem_size);
+   record_done();
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
+
+int tuner_record_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
+{
+   uint64_t timestamp = now();
+   int error = m_device.transact(write_buffer, write_size, read_buffer, read_size);
+   pthread_mutex_lock(&m_lock);
+   record(TUNER_TRACE_TRANSACT, error, timestamp, write_buffer, (error ? 0 : write_size),
+      read_buffer, (error ? 0 : read_size), 1);
+   record_done();
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
+
+int tuner_record_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   uint64_t timestamp = now();
+   int error = m_device.submit(ops, num_ops);
+   // Which operations of a failed batch ran is unknown, so none are recorded.
+   size_t count = (error ? 0 : num_ops);
+   pthread_mutex_lock(&m_lock);
+   record(TUNER_TRACE_SUBMIT, error, timestamp, NULL, 0, NULL, 0, count);
+   for (size_t i = 0; i < count; ++i)
+   {
+      switch (ops[i].type)
+      {
+         case TUNER_OP_WRITE:
+            record(TUNER_TRACE_WRITE, 0, timestamp, ops[i].write_buffer, ops[i].write_size, NULL, 0, 1);
+            break;
+         case TUNER_OP_READ:
+            record(TUNER_TRACE_READ, 0, timestamp, NULL, 0, ops[i].read_buffer, ops[i].read_size, 1);
+            break;
+         default:
+            record(TUNER_TRACE_TRANSACT, 0, timestamp, ops[i].write_buffer, ops[i].write_size,
+               ops[i].read_buffer, ops[i].read_size, 1);
+            break;
+      }
+   }
+   record_done();
+   pthread_mutex_unlock(&m_lock);
+   return error;
+}
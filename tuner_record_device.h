@@ -0,0 +1,131 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_RECORD_DEVICE_H__
+#define __TUNER_RECORD_DEVICE_H__
+
+#include <stdio.h>
+#include <pthread.h>
+#include "tuner_device.h"
+#include "tuner_trace.h"
+
+/*
+ * Passes every operation through to another device and appends it to a
+ * trace file, including the data read back.  See tuner_trace.h.  Records
+ * are buffered and written when the buffer fills, on flush() and when the
+ * device is destroyed, unless set_flush_each() asks for every record to be
+ * written as it completes.
+ */
+class tuner_record_device
+   : public tuner_device
+{
+   public:
+
+      tuner_record_device(tuner_config &config, tuner_device &device, const char *filename, int &error);
+
+      virtual ~tuner_record_device(void);
+
+      virtual int write(const uint8_t *buffer, size_t size, size_t &written);
+
+      virtual int read(uint8_t *buffer, size_t size, size_t &read);
+
+      virtual int write(const struct iovec *iov, size_t iovcnt);
+
+      virtual int write_array(const uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int read_array(uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
+
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      virtual size_t max_transfer_size(void)
+      {
+         return m_device.max_transfer_size();
+      }
+
+      virtual void set_write_combining(bool enable)
+      {
+         tuner_device::set_write_combining(enable);
+         m_device.set_write_combining(enable);
+      }
+
+      virtual int set_bus_speed(uint32_t hz)
+      {
+         return m_device.set_bus_speed(hz);
+      }
+
+      virtual int get_bus_speed(uint32_t &hz)
+      {
+         return m_device.get_bus_speed(hz);
+      }
+
+      virtual void lock_bus(void)
+      {
+         m_device.lock_bus();
+      }
+
+      virtual void unlock_bus(void)
+      {
+         m_device.unlock_bus();
+      }
+
+      void set_flush_each(bool enable);
+
+      int flush(void);
+
+   private:
+
+      void record_header(
+         tuner_trace_type type,
+         int error,
+         uint64_t timestamp,
+         size_t write_size,
+         size_t read_size,
+         size_t count);
+
+      void record(
+         tuner_trace_type type,
+         int error,
+         uint64_t timestamp,
+         const uint8_t *write_buffer,
+         size_t write_size,
+         const uint8_t *read_buffer,
+         size_t read_size,
+         size_t count);
+
+      void record_done(void);
+
+      static uint64_t now(void);
+
+      tuner_device &m_device;
+      FILE *m_stream;
+      bool m_flush_each;
+      pthread_mutex_t m_lock;
+};
+
+#endif
@@ -0,0 +1,445 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/errno.h>
+#include <string.h>
+#include <new>
+#include "tuner_regcache_device.h"
+
+tuner_regcache_device::tuner_regcache_device(
+   tuner_config &config,
+   tuner_device &device,
+   size_t addr_bytes,
+   size_t value_bytes,
+   bool auto_increment,
+   int &error)
+   : tuner_device(config),
+     m_device(device),
+     m_addr_bytes(addr_bytes),
+     m_value_bytes(value_bytes),
+     m_auto_increment(auto_increment)
+{
+   if (error)
+   {
+      return;
+   }
+   if ((addr_bytes < 1) || (addr_bytes > MAX_ADDR_BYTES) || (value_bytes < 1) || (value_bytes > MAX_VALUE_BYTES))
+   {
+      error = EINVAL;
+      return;
+   }
+   try
+   {
+      m_values.resize((size_t)1 << (8 * addr_bytes), 0);
+      m_flags.resize((size_t)1 << (8 * addr_bytes), 0);
+   }
+   catch(...)
+   {
+      error = ENOMEM;
+   }
+}
+
+void tuner_regcache_device::set_static(uint16_t first, uint16_t last)
+{
+   for (size_t reg = first; reg <= last; ++reg)
+   {
+      m_flags[reg] = (m_flags[reg] & ~REG_VOLATILE) | REG_STATIC;
+   }
+}
+
+void tuner_regcache_device::set_volatile(uint16_t first, uint16_t last)
+{
+   for (size_t reg = first; reg <= last; ++reg)
+   {
+      m_flags[reg] = REG_VOLATILE;
+   }
+}
+
+void tuner_regcache_device::invalidate(void)
+{
+   for (size_t reg = 0; reg < m_flags.size(); ++reg)
+   {
+      m_flags[reg] &= ~REG_VALID;
+   }
+}
+
+uint16_t tuner_regcache_device::decode_addr(const uint8_t *buffer)
+{
+   uint16_t addr = 0;
+   for (size_t i = 0; i < m_addr_bytes; ++i)
+   {
+      addr = (addr << 8) | buffer[i];
+   }
+   return addr;
+}
+
+uint16_t tuner_regcache_device::decode_value(const uint8_t *buffer)
+{
+   uint16_t value = 0;
+   for (size_t i = 0; i < m_value_bytes; ++i)
+   {
+      value = (value << 8) | buffer[i];
+   }
+   return value;
+}
+
+/*
+ * Number of register values carried by a write message, or 0 if the
+ * message can't be interpreted as one.
+ */
+size_t tuner_regcache_device::value_count(size_t size)
+{
+   if ((size <= m_addr_bytes) || (((size - m_addr_bytes) % m_value_bytes) != 0))
+   {
+      return 0;
+   }
+   size_t count = (size - m_addr_bytes) / m_value_bytes;
+   if (!m_auto_increment && (count > 1))
+   {
+      return 0;
+   }
+   return count;
+}
+
+/*
+ * Finds the first and last value in a write message that differ from the
+ * shadow.  Returns false if nothing would change.
+ */
+bool tuner_regcache_device::changed_range(const uint8_t *buffer, size_t size, size_t &first, size_t &last)
+{
+   size_t count = value_count(size);
+   first = 0;
+   last = 0;
+   if (count == 0)
+   {
+      return true;
+   }
+   uint16_t reg = decode_addr(buffer);
+   bool changed = false;
+   for (size_t i = 0; i < count; ++i, reg = next_reg(reg))
+   {
+      uint8_t flags = m_flags[reg];
+      if (!(flags & REG_VALID) || (flags & REG_VOLATILE) ||
+          (m_values[reg] != decode_value(buffer + m_addr_bytes + (i * m_value_bytes))))
+      {
+         if (!changed)
+         {
+            first = i;
+         }
+         last = i;
+         changed = true;
+      }
+   }
+   return changed;
+}
+
+void tuner_regcache_device::store(const uint8_t *buffer, size_t size)
+{
+   size_t count = value_count(size);
+   if (count == 0)
+   {
+      invalidate(buffer, size);
+      return;
+   }
+   uint16_t reg = decode_addr(buffer);
+   for (size_t i = 0; i < count; ++i, reg = next_reg(reg))
+   {
+      if (!(m_flags[reg] & REG_VOLATILE))
+      {
+         m_values[reg] = decode_value(buffer + m_addr_bytes + (i * m_value_bytes));
+         m_flags[reg] |= REG_VALID;
+      }
+   }
+}
+
+void tuner_regcache_device::invalidate(const uint8_t *buffer, size_t size)
+{
+   if (size < m_addr_bytes)
+   {
+      return;
+   }
+   size_t count = (size - m_addr_bytes + m_value_bytes - 1) / m_value_bytes;
+   if (!m_auto_increment && (count > 1))
+   {
+      count = 1;
+   }
+   if (count > m_flags.size())
+   {
+      count = m_flags.size();
+   }
+   uint16_t reg = decode_addr(buffer);
+   for (size_t i = 0; i < count; ++i, reg = next_reg(reg))
+   {
+      m_flags[reg] &= ~REG_VALID;
+   }
+}
+
+int tuner_regcache_device::write(const uint8_t *buffer, size_t size, size_t &written)
+{
+   size_t first = 0, last = 0;
+   if (!changed_range(buffer, size, first, last))
+   {
+      written = size;
+      return 0;
+   }
+   int error = 0;
+   size_t count = value_count(size);
+   if ((count == 0) || ((first == 0) && (last == (count - 1))))
+   {
+      error = m_device.write(buffer, size, written);
+   }
+   else
+   {
+      // Rewrite the message to cover only the changed registers
+      size_t trimmed_size = m_addr_bytes + ((last - first + 1) * m_value_bytes);
+      uint8_t stackbuf[64];
+      uint8_t *trimmed = stackbuf;
+      if (trimmed_size > sizeof(stackbuf))
+      {
+         trimmed = new(std::nothrow) uint8_t[trimmed_size];
+         if (trimmed == NULL)
+         {
+            return ENOMEM;
+         }
+      }
+      uint16_t reg = decode_addr(buffer) + first;
+      for (size_t i = m_addr_bytes; i > 0; --i)
+      {
+         trimmed[i - 1] = reg & 0xFF;
+         reg >>= 8;
+      }
+      memcpy(trimmed + m_addr_bytes, buffer + m_addr_bytes + (first * m_value_bytes), trimmed_size - m_addr_bytes);
+      size_t trimmed_written = 0;
+      error = m_device.write(trimmed, trimmed_size, trimmed_written);
+      if (trimmed != stackbuf)
+      {
+         delete[] trimmed;
+      }
+      if (!error)
+      {
+         written = size;
+      }
+   }
+   if (error)
+   {
+      invalidate(buffer, size);
+   }
+   else
+   {
+      store(buffer, size);
+   }
+   return error;
+}
+
+int tuner_regcache_device::read(uint8_t *buffer, size_t size, size_t &read)
+{
+   return m_device.read(buffer, size, read);
+}
+
+int tuner_regcache_device::write(const struct iovec *iov, size_t iovcnt)
+{
+   int error = m_device.write(iov, iovcnt);
+   if ((iovcnt > 0) && (iov[0].iov_len >= m_addr_bytes))
+   {
+      size_t total = 0;
+      for (size_t i = 0; i < iovcnt; ++i)
+      {
+         total += iov[i].iov_len;
+      }
+      // Gathered writes are bulk transfers; just forget what they cover
+      uint8_t header[MAX_ADDR_BYTES];
+      memcpy(header, iov[0].iov_base, m_addr_bytes);
+      invalidate(header, total);
+   }
+   return error;
+}
+
+int tuner_regcache_device::write_array(const uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   if ((elem_size == 0) || ((total_size % elem_size) != 0))
+   {
+      return EINVAL;
+   }
+   uint8_t stackbuf[256];
+   uint8_t *filtered = stackbuf;
+   if (total_size > sizeof(stackbuf))
+   {
+      filtered = new(std::nothrow) uint8_t[total_size];
+      if (filtered == NULL)
+      {
+         return ENOMEM;
+      }
+   }
+   // Only whole elements are dropped, so the array stays uniform.  The
+   // shadow is updated as each element is accepted, so a register written
+   // twice in one array is compared against its earlier value in the array.
+   size_t filtered_size = 0;
+   for (size_t i = 0; i < total_size; i += elem_size)
+   {
+      size_t first = 0, last = 0;
+      if (changed_range(buffer + i, elem_size, first, last))
+      {
+         memcpy(filtered + filtered_size, buffer + i, elem_size);
+         filtered_size += elem_size;
+         store(buffer + i, elem_size);
+      }
+   }
+   int error = 0;
+   if (filtered_size > 0)
+   {
+      error = m_device.write_array(filtered, elem_size, filtered_size);
+   }
+   for (size_t i = 0; error && (i < filtered_size); i += elem_size)
+   {
+      invalidate(filtered + i, elem_size);
+   }
+   if (filtered != stackbuf)
+   {
+      delete[] filtered;
+   }
+   return error;
+}
+
+int tuner_regcache_device::read_array(uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   return m_device.read_array(buffer, elem_size, total_size);
+}
+
+int tuner_regcache_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
+{
+   if ((write_size != m_addr_bytes) || (read_size == 0) || ((read_size % m_value_bytes) != 0) ||
+       (!m_auto_increment && (read_size > m_value_bytes)))
+   {
+      return m_device.transact(write_buffer, write_size, read_buffer, read_size);
+   }
+   size_t count = read_size / m_value_bytes;
+   uint16_t first_reg = decode_addr(write_buffer);
+   uint16_t reg = first_reg;
+   bool cached = true;
+   for (size_t i = 0; cached && (i < count); ++i, reg = next_reg(reg))
+   {
+      cached = ((m_flags[reg] & (REG_STATIC | REG_VALID)) == (REG_STATIC | REG_VALID));
+   }
+   reg = first_reg;
+   if (cached)
+   {
+      for (size_t i = 0; i < count; ++i, reg = next_reg(reg))
+      {
+         uint16_t value = m_values[reg];
+         for (size_t j = m_value_bytes; j > 0; --j)
+         {
+            read_buffer[(i * m_value_bytes) + j - 1] = value & 0xFF;
+            value >>= 8;
+         }
+      }
+      return 0;
+   }
+   int error = m_device.transact(write_buffer, write_size, read_buffer, read_size);
+   for (size_t i = 0; !error && (i < count); ++i, reg = next_reg(reg))
+   {
+      if (m_flags[reg] & REG_STATIC)
+      {
+         m_values[reg] = decode_value(read_buffer + (i * m_value_bytes));
+         m_flags[reg] |= REG_VALID;
+      }
+   }
+   return error;
+}
+
+int tuner_regcache_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   tuner_op stackops[16];
+   tuner_op *filtered = stackops;
+   if (num_ops > (sizeof(stackops) / sizeof(stackops[0])))
+   {
+      filtered = new(std::nothrow) tuner_op[num_ops];
+      if (filtered == NULL)
+      {
+         return ENOMEM;
+      }
+   }
+   // Dropping a write cannot reorder the rest of the batch, but trimming
+   // would need storage per op, so changed writes are sent whole.  As in
+   // write_array(), accepted writes update the shadow immediately.
+   size_t num_filtered = 0;
+   for (size_t i = 0; i < num_ops; ++i)
+   {
+      size_t first = 0, last = 0;
+      if (ops[i].type != TUNER_OP_WRITE)
+      {
+         filtered[num_filtered++] = ops[i];
+      }
+      else if (changed_range(ops[i].write_buffer, ops[i].write_size, first, last))
+      {
+         filtered[num_filtered++] = ops[i];
+         store(ops[i].write_buffer, ops[i].write_size);
+      }
+   }
+   int error = 0;
+   if (num_filtered > 0)
+   {
+      error = m_device.submit(filtered, num_filtered);
+   }
+   for (size_t i = 0; error && (i < num_filtered); ++i)
+   {
+      if (filtered[i].type != TUNER_OP_READ)
+      {
+         invalidate(filtered[i].write_buffer, filtered[i].write_size);
+      }
+   }
+   if (filtered != stackops)
+   {
+      delete[] filtered;
+   }
+   return error;
+}
+
+int tuner_regcache_device::update_bits(uint8_t reg, uint8_t mask, uint8_t value)
+{
+   if ((m_addr_bytes != 1) || (m_value_bytes != 1) || ((m_flags[reg] & (REG_VALID | REG_VOLATILE)) != REG_VALID))
+   {
+      return tuner_device::update_bits(reg, mask, value);
+   }
+   uint8_t buffer[2];
+   buffer[0] = reg;
+   buffer[1] = (m_values[reg] & ~mask) | (value & mask);
+   return tuner_device::write(buffer, sizeof(buffer));
+}
+
+int tuner_regcache_device::update_bits16(uint8_t reg, uint16_t mask, uint16_t value)
+{
+   if ((m_addr_bytes != 1) || (m_value_bytes != 2) || ((m_flags[reg] & (REG_VALID | REG_VOLATILE)) != REG_VALID))
+   {
+      return tuner_device::update_bits16(reg, mask, value);
+   }
+   uint16_t updated = (m_values[reg] & ~mask) | (value & mask);
+   uint8_t buffer[3];
+   buffer[0] = reg;
+   buffer[1] = (updated >> 8) & 0xFF;
+   buffer[2] = updated & 0xFF;
+   return tuner_device::write(buffer, sizeof(buffer));
+}
@@ -0,0 +1,154 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_REGCACHE_DEVICE_H__
+#define __TUNER_REGCACHE_DEVICE_H__
+
+#include <vector>
+#include "tuner_device.h"
+
+/*
+ * Register shadow over another device, for chips addressed as
+ * [register, value...] messages.  Writes that would not change the last
+ * value written are dropped, and multi-register writes are trimmed to the
+ * registers that changed.  Transacted reads of registers marked static are
+ * answered from the cache once they have been read.  Registers marked
+ * volatile (status, FIFO and strobe registers) are always passed through.
+ * Addresses and values may each be 1 or 2 bytes; the constructor fails with
+ * EINVAL otherwise.
+ */
+class tuner_regcache_device
+   : public tuner_device
+{
+   public:
+
+      tuner_regcache_device(
+         tuner_config &config,
+         tuner_device &device,
+         size_t addr_bytes,
+         size_t value_bytes,
+         bool auto_increment,
+         int &error);
+
+      virtual ~tuner_regcache_device(void) {}
+
+      virtual int write(const uint8_t *buffer, size_t size, size_t &written);
+
+      virtual int read(uint8_t *buffer, size_t size, size_t &read);
+
+      virtual int write(const struct iovec *iov, size_t iovcnt);
+
+      virtual int write_array(const uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int read_array(uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
+
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      virtual size_t max_transfer_size(void)
+      {
+         return m_device.max_transfer_size();
+      }
+
+      virtual void set_write_combining(bool enable)
+      {
+         tuner_device::set_write_combining(enable);
+         m_device.set_write_combining(enable);
+      }
+
+      virtual int update_bits(uint8_t reg, uint8_t mask, uint8_t value);
+
+      virtual int update_bits16(uint8_t reg, uint16_t mask, uint16_t value);
+
+      virtual int set_bus_speed(uint32_t hz)
+      {
+         return m_device.set_bus_speed(hz);
+      }
+
+      virtual int get_bus_speed(uint32_t &hz)
+      {
+         return m_device.get_bus_speed(hz);
+      }
+
+      virtual void lock_bus(void)
+      {
+         m_device.lock_bus();
+      }
+
+      virtual void unlock_bus(void)
+      {
+         m_device.unlock_bus();
+      }
+
+      void set_static(uint16_t first, uint16_t last);
+
+      void set_volatile(uint16_t first, uint16_t last);
+
+      void invalidate(void);
+
+   private:
+
+      enum
+      {
+         MAX_ADDR_BYTES  = 2,
+         MAX_VALUE_BYTES = 2
+      };
+
+      enum
+      {
+         REG_VALID    = 0x1,
+         REG_STATIC   = 0x2,
+         REG_VOLATILE = 0x4
+      };
+
+      uint16_t decode_addr(const uint8_t *buffer);
+
+      uint16_t decode_value(const uint8_t *buffer);
+
+      uint16_t next_reg(uint16_t reg)
+      {
+         return ((reg + 1) & (m_flags.size() - 1));
+      }
+
+      size_t value_count(size_t size);
+
+      bool changed_range(const uint8_t *buffer, size_t size, size_t &first, size_t &last);
+
+      void store(const uint8_t *buffer, size_t size);
+
+      void invalidate(const uint8_t *buffer, size_t size);
+
+      tuner_device &m_device;
+      size_t m_addr_bytes;
+      size_t m_value_bytes;
+      bool m_auto_increment;
+      std::vector<uint16_t> m_values;
+      std::vector<uint8_t> m_flags;
+};
+
+#endif
@@ -0,0 +1,271 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/errno.h>
+#include <sys/mman.h>
+#include <string.h>
+#include "tuner_replay_device.h"
+
+tuner_replay_device::tuner_replay_device(tuner_config &config, const char *filename, bool strict, int &error)
+   : tuner_device(config),
+     m_buffer(NULL),
+     m_length(0),
+     m_offset(sizeof(tuner_trace_header)),
+     m_stream(NULL),
+     m_strict(strict)
+{
+   if (error)
+   {
+      return;
+   }
+   if ((m_stream = fopen(filename, "r")) == NULL)
+   {
+      error = ENOENT;
+      return;
+   }
+   fseek(m_stream, 0, SEEK_END);
+   m_length = ftell(m_stream);
+   if (m_length < sizeof(tuner_trace_header))
+   {
+      error = EINVAL;
+      return;
+   }
+   void *buffer = mmap(NULL, m_length, PROT_READ, MAP_PRIVATE, fileno(m_stream), 0);
+   if (buffer == MAP_FAILED)
+   {
+      error = ENOMEM;
+      return;
+   }
+   m_buffer = reinterpret_cast<uint8_t*>(buffer);
+   tuner_trace_header header;
+   memcpy(&header, m_buffer, sizeof(header));
+   if ((header.magic != TUNER_TRACE_MAGIC) || (header.version != TUNER_TRACE_VERSION))
+   {
+      LIBTUNERERR << "Trace file " << filename << " has unsupported format" << std::endl;
+      error = EINVAL;
+   }
+}
+
+tuner_replay_device::~tuner_replay_device(void)
+{
+   if (m_buffer != NULL)
+   {
+      munmap(m_buffer, m_length);
+      m_buffer = NULL;
+   }
+   if (m_stream != NULL)
+   {
+      fclose(m_stream);
+      m_stream = NULL;
+   }
+}
+
+void tuner_replay_device::rewind(void)
+{
+   m_offset = sizeof(tuner_trace_header);
+}
+
+bool tuner_replay_device::next(tuner_trace_record &rec, const uint8_t *&payload)
+{
+   if ((m_offset + sizeof(rec)) > m_length)
+   {
+      return false;
+   }
+   // Records are packed, so copy out rather than casting in place
+   memcpy(&rec, m_buffer + m_offset, sizeof(rec));
+   size_t size = sizeof(rec) + rec.write_size + rec.read_size;
+   if ((m_offset + size) > m_length)
+   {
+      return false;
+   }
+   payload = m_buffer + m_offset + sizeof(rec);
+   m_offset += size;
+   return true;
+}
+
+bool tuner_replay_device::next_read(size_t size, tuner_trace_record &rec, const uint8_t *&payload)
+{
+   while (next(rec, payload))
+   {
+      if ((rec.read_size == size) && (rec.type != TUNER_TRACE_SUBMIT))
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+int tuner_replay_device::replay(
+   tuner_trace_type type,
+   const uint8_t *write_buffer,
+   size_t write_size,
+   uint8_t *read_buffer,
+   size_t read_size,
+   size_t count,
+   size_t &transferred)
+{
+   static const tuner_stat_op stat_ops[] =
+   {
+      TUNER_STAT_WRITE,
+      TUNER_STAT_READ,
+      TUNER_STAT_TRANSACT,
+      TUNER_STAT_WRITE,
+      TUNER_STAT_READ
+   };
+   uint64_t start = io_begin();
+   int error = replay_record(type, write_buffer, write_size, read_buffer, read_size, count, transferred);
+   io_end(stat_ops[type], start, error, write_size, read_size);
+   return error;
+}
+
+int tuner_replay_device::replay_record(
+   tuner_trace_type type,
+   const uint8_t *write_buffer,
+   size_t write_size,
+   uint8_t *read_buffer,
+   size_t read_size,
+   size_t count,
+   size_t &transferred)
+{
+   tuner_trace_record rec;
+   const uint8_t *payload = NULL;
+   bool found = false;
+   transferred = write_size + read_size;
+   if (!m_strict)
+   {
+      if (read_size == 0)
+      {
+         return 0;
+      }
+      found = next_read(read_size, rec, payload);
+   }
+   else
+   {
+      // Failed operations record no data, and plain reads and writes may be short.
+      size_t offset = m_offset;
+      found = next(rec, payload);
+      if (found)
+      {
+         bool short_ok = ((rec.error != 0) || (type == TUNER_TRACE_WRITE) || (type == TUNER_TRACE_READ));
+         if ((rec.type != type) || (rec.count != count) ||
+             (rec.write_size > write_size) || (rec.read_size > read_size) ||
+             (!short_ok && ((rec.write_size != write_size) || (rec.read_size != read_size))) ||
+             (memcmp(payload, write_buffer, rec.write_size) != 0))
+         {
+            LIBTUNERERR << "Replay diverged from trace at offset " << offset << std::endl;
+            return EIO;
+         }
+      }
+   }
+   if (!found)
+   {
+      LIBTUNERERR << "Replay ran past end of trace" << std::endl;
+      return EIO;
+   }
+   if (rec.read_size > 0)
+   {
+      memcpy(read_buffer, payload + rec.write_size, rec.read_size);
+   }
+   transferred = rec.write_size + rec.read_size;
+   return rec.error;
+}
+
+int tuner_replay_device::write(const uint8_t *buffer, size_t size, size_t &written)
+{
+   size_t transferred = 0;
+   int error = replay(TUNER_TRACE_WRITE, buffer, size, NULL, 0, 1, transferred);
+   if (!error)
+   {
+      written = transferred;
+   }
+   return error;
+}
+
+int tuner_replay_device::read(uint8_t *buffer, size_t size, size_t &read)
+{
+   size_t transferred = 0;
+   int error = replay(TUNER_TRACE_READ, NULL, 0, buffer, size, 1, transferred);
+   if (!error)
+   {
+      read = transferred;
+   }
+   return error;
+}
+
+int tuner_replay_device::write_array(const uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   size_t transferred = 0;
+   return replay(TUNER_TRACE_WRITE_ARRAY, buffer, total_size, NULL, 0, elem_size, transferred);
+}
+
+int tuner_replay_device::read_array(uint8_t *buffer, size_t elem_size, size_t total_size)
+{
+   size_t transferred = 0;
+   return replay(TUNER_TRACE_READ_ARRAY, NULL, 0, buffer, total_size, elem_size, transferred);
+}
+
+int tuner_replay_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
+{
+   size_t transferred = 0;
+   return replay(TUNER_TRACE_TRANSACT, write_buffer, write_size, read_buffer, read_size, 1, transferred);
+}
+
+int tuner_replay_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   if (!m_strict)
+   {
+      return tuner_device::submit(ops, num_ops);
+   }
+   tuner_trace_record rec;
+   const uint8_t *payload = NULL;
+   // A failed batch is recorded without its operations.
+   if (!next(rec, payload) || (rec.type != TUNER_TRACE_SUBMIT) ||
+       ((rec.count != num_ops) && ((rec.error == 0) || (rec.count != 0))))
+   {
+      LIBTUNERERR << "Replay diverged from trace at submit" << std::endl;
+      return EIO;
+   }
+   int error = 0;
+   size_t transferred = 0;
+   for (size_t i = 0; !error && (i < rec.count); ++i)
+   {
+      switch (ops[i].type)
+      {
+         case TUNER_OP_WRITE:
+            error = replay(TUNER_TRACE_WRITE, ops[i].write_buffer, ops[i].write_size, NULL, 0, 1, transferred);
+            break;
+         case TUNER_OP_READ:
+            error = replay(TUNER_TRACE_READ, NULL, 0, ops[i].read_buffer, ops[i].read_size, 1, transferred);
+            break;
+         default:
+            error = replay(TUNER_TRACE_TRANSACT, ops[i].write_buffer, ops[i].write_size,
+               ops[i].read_buffer, ops[i].read_size, 1, transferred);
+            break;
+      }
+   }
+   return (error ? error : rec.error);
+}
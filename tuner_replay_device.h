@@ -0,0 +1,102 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_REPLAY_DEVICE_H__
+#define __TUNER_REPLAY_DEVICE_H__
+
+#include <stdio.h>
+#include "tuner_device.h"
+#include "tuner_trace.h"
+
+/*
+ * Plays back a trace written by tuner_record_device.  In strict mode every
+ * operation must match the next record, including written data; any
+ * divergence fails with EIO.  Otherwise writes are accepted without
+ * checking and each read is answered from the next recorded read of the
+ * same size, so a driver that batches or combines its writes differently
+ * can still be run against an old trace.
+ */
+class tuner_replay_device
+   : public tuner_device
+{
+   public:
+
+      tuner_replay_device(tuner_config &config, const char *filename, bool strict, int &error);
+
+      virtual ~tuner_replay_device(void);
+
+      virtual int write(const uint8_t *buffer, size_t size, size_t &written);
+
+      virtual int read(uint8_t *buffer, size_t size, size_t &read);
+
+      virtual int write_array(const uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int read_array(uint8_t *buffer, size_t elem_size, size_t total_size);
+
+      virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
+
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      void rewind(void);
+
+      bool finished(void)
+      {
+         return (m_offset >= m_length);
+      }
+
+   private:
+
+      bool next(tuner_trace_record &rec, const uint8_t *&payload);
+
+      bool next_read(size_t size, tuner_trace_record &rec, const uint8_t *&payload);
+
+      int replay(
+         tuner_trace_type type,
+         const uint8_t *write_buffer,
+         size_t write_size,
+         uint8_t *read_buffer,
+         size_t read_size,
+         size_t count,
+         size_t &transferred);
+
+      int replay_record(
+         tuner_trace_type type,
+         const uint8_t *write_buffer,
+         size_t write_size,
+         uint8_t *read_buffer,
+         size_t read_size,
+         size_t count,
+         size_t &transferred);
+
+      uint8_t *m_buffer;
+      size_t m_length;
+      size_t m_offset;
+      FILE *m_stream;
+      bool m_strict;
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/errno.h>
+#include <unistd.h>
+#include "tuner_sim_device.h"
+
+const tuner_sim_timing TUNER_SIM_TIMING_I2C_100KHZ = {100000, 0};
+const tuner_sim_timing TUNER_SIM_TIMING_I2C_400KHZ = {400000, 0};
+const tuner_sim_timing TUNER_SIM_TIMING_USB_BRIDGE = {100000, 1000};
+
+tuner_sim_device::tuner_sim_device(
+   tuner_config &config,
+   tuner_sim_model &model,
+   const tuner_sim_timing &timing,
+   bool realtime)
+   : tuner_device(config),
+     m_model(model),
+     m_timing(timing),
+     m_realtime(realtime),
+     m_batched(false),
+     m_max_transfer(0),
+     m_pending_bits(0)
+{
+   reset_sim_stats();
+}
+
+void tuner_sim_device::reset_sim_stats(void)
+{
+   m_stats.transactions = 0;
+   m_stats.bytes_written = 0;
+   m_stats.bytes_read = 0;
+   m_stats.bus_time_us = 0;
+}
+
+void tuner_sim_device::begin_transaction(void)
+{
+   if (!m_batched)
+   {
+      m_pending_bits = 0;
+   }
+}
+
+void tuner_sim_device::transfer(size_t bytes)
+{
+   // Address byte plus payload, 9 clocks per byte including ACK
+   m_pending_bits += (bytes + 1) * 9;
+}
+
+void tuner_sim_device::end_transaction(void)
+{
+   if (m_batched)
+   {
+      return;
+   }
+   uint64_t us = m_timing.transaction_us;
+   if (m_timing.bus_hz != 0)
+   {
+      us += (m_pending_bits * 1000000) / m_timing.bus_hz;
+   }
+   ++m_stats.transactions;
+   m_stats.bus_time_us += us;
+   m_pending_bits = 0;
+   if (m_realtime && (us > 0))
+   {
+      usleep(us);
+   }
+}
+
+int tuner_sim_device::write(const uint8_t *buffer, size_t size, size_t &written)
+{
+   uint64_t start = io_begin();
+   begin_transaction();
+   transfer(size);
+   int error = m_model.write(buffer, size);
+   end_transaction();
+   if (!error)
+   {
+      written = size;
+      m_stats.bytes_written += size;
+   }
+   if (!m_batched)
+   {
+      io_end(TUNER_STAT_WRITE, start, error, size, 0);
+   }
+   return error;
+}
+
+int tuner_sim_device::read(uint8_t *buffer, size_t size, size_t &read)
+{
+   uint64_t start = io_begin();
+   begin_transaction();
+   transfer(size);
+   int error = m_model.read(buffer, size);
+   end_transaction();
+   if (!error)
+   {
+      read = size;
+      m_stats.bytes_read += size;
+   }
+   if (!m_batched)
+   {
+      io_end(TUNER_STAT_READ, start, error, 0, size);
+   }
+   return error;
+}
+
+int tuner_sim_device::transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size)
+{
+   uint64_t start = io_begin();
+   begin_transaction();
+   transfer(write_size);
+   transfer(read_size);
+   int error = m_model.write(write_buffer, write_size);
+   error = (error ? error : m_model.read(read_buffer, read_size));
+   end_transaction();
+   if (!error)
+   {
+      m_stats.bytes_written += write_size;
+      m_stats.bytes_read += read_size;
+   }
+   if (!m_batched)
+   {
+      io_end(TUNER_STAT_TRANSACT, start, error, write_size, read_size);
+   }
+   return error;
+}
+
+int tuner_sim_device::submit(const tuner_op *ops, size_t num_ops)
+{
+   uint64_t start = io_begin();
+   m_pending_bits = 0;
+   m_batched = true;
+   int error = tuner_device::submit(ops, num_ops);
+   m_batched = false;
+   end_transaction();
+   size_t written = 0, read = 0;
+   for (size_t i = 0; i < num_ops; ++i)
+   {
+      written += ops[i].write_size;
+      read += ops[i].read_size;
+   }
+   io_end(TUNER_STAT_SUBMIT, start, error, written, read);
+   return error;
+}
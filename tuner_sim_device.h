@@ -0,0 +1,145 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_SIM_DEVICE_H__
+#define __TUNER_SIM_DEVICE_H__
+
+#include "tuner_device.h"
+
+typedef struct
+{
+   uint32_t bus_hz;
+   uint32_t transaction_us;
+} tuner_sim_timing;
+
+extern const tuner_sim_timing TUNER_SIM_TIMING_I2C_100KHZ;
+extern const tuner_sim_timing TUNER_SIM_TIMING_I2C_400KHZ;
+extern const tuner_sim_timing TUNER_SIM_TIMING_USB_BRIDGE;
+
+/*
+ * In-memory model of a chip as seen from the bus.  Each write and read is
+ * one message addressed to the chip.
+ */
+class tuner_sim_model
+{
+   public:
+
+      virtual ~tuner_sim_model(void) {}
+
+      virtual int write(const uint8_t *buffer, size_t size) = 0;
+
+      virtual int read(uint8_t *buffer, size_t size) = 0;
+
+      virtual void reset(void) {}
+};
+
+typedef struct
+{
+   uint64_t transactions;
+   uint64_t bytes_written;
+   uint64_t bytes_read;
+   uint64_t bus_time_us;
+} tuner_sim_stats;
+
+/*
+ * Device backed by a tuner_sim_model.  Bus time is computed from the timing
+ * profile for every transaction; if realtime is set the device also sleeps
+ * for that long, so driver-side timing can be measured.
+ */
+class tuner_sim_device
+   : public tuner_device
+{
+   public:
+
+      tuner_sim_device(
+         tuner_config &config,
+         tuner_sim_model &model,
+         const tuner_sim_timing &timing,
+         bool realtime);
+
+      virtual ~tuner_sim_device(void) {}
+
+      virtual int write(const uint8_t *buffer, size_t size, size_t &written);
+
+      virtual int read(uint8_t *buffer, size_t size, size_t &read);
+
+      virtual int transact(const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size);
+
+      virtual int submit(const tuner_op *ops, size_t num_ops);
+
+      virtual size_t max_transfer_size(void)
+      {
+         return m_max_transfer;
+      }
+
+      void set_max_transfer_size(size_t size)
+      {
+         m_max_transfer = size;
+      }
+
+      virtual int set_bus_speed(uint32_t hz)
+      {
+         m_timing.bus_hz = hz;
+         return 0;
+      }
+
+      virtual int get_bus_speed(uint32_t &hz)
+      {
+         hz = m_timing.bus_hz;
+         return 0;
+      }
+
+      void set_timing(const tuner_sim_timing &timing)
+      {
+         m_timing = timing;
+      }
+
+      void get_sim_stats(tuner_sim_stats &stats)
+      {
+         stats = m_stats;
+      }
+
+      void reset_sim_stats(void);
+
+   protected:
+
+      void begin_transaction(void);
+
+      void end_transaction(void);
+
+      void transfer(size_t bytes);
+
+      tuner_sim_model &m_model;
+      tuner_sim_timing m_timing;
+      bool m_realtime;
+      bool m_batched;
+      size_t m_max_transfer;
+      uint64_t m_pending_bits;
+      tuner_sim_stats m_stats;
+};
+
+#endif
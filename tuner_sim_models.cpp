@@ -0,0 +1,252 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#include <sys/errno.h>
+#include <string.h>
+#include <algorithm>
+#include "tuner_sim_models.h"
+
+tuner_sim_regmap::tuner_sim_regmap(size_t addr_bytes, size_t value_bytes, bool auto_increment)
+   : m_addr_bytes(addr_bytes),
+     m_value_bytes(value_bytes),
+     m_auto_increment(auto_increment),
+     m_pointer(0),
+     m_regs((size_t)1 << (8 * addr_bytes), 0)
+{
+}
+
+void tuner_sim_regmap::reset(void)
+{
+   m_pointer = 0;
+   std::fill(m_regs.begin(), m_regs.end(), 0);
+}
+
+void tuner_sim_regmap::advance(void)
+{
+   if (m_auto_increment)
+   {
+      m_pointer = (m_pointer + 1) & (m_regs.size() - 1);
+   }
+}
+
+int tuner_sim_regmap::write(const uint8_t *buffer, size_t size)
+{
+   if (size < m_addr_bytes)
+   {
+      return EIO;
+   }
+   m_pointer = 0;
+   for (size_t i = 0; i < m_addr_bytes; ++i)
+   {
+      m_pointer = (m_pointer << 8) | buffer[i];
+   }
+   for (size_t i = m_addr_bytes; (i + m_value_bytes) <= size; i += m_value_bytes)
+   {
+      uint16_t value = 0;
+      for (size_t j = 0; j < m_value_bytes; ++j)
+      {
+         value = (value << 8) | buffer[i + j];
+      }
+      m_regs[m_pointer] = value;
+      reg_written(m_pointer, value);
+      advance();
+   }
+   return 0;
+}
+
+int tuner_sim_regmap::read(uint8_t *buffer, size_t size)
+{
+   for (size_t i = 0; (i + m_value_bytes) <= size; i += m_value_bytes)
+   {
+      uint16_t value = reg_read(m_pointer);
+      for (size_t j = m_value_bytes; j > 0; --j)
+      {
+         buffer[i + j - 1] = value & 0xFF;
+         value >>= 8;
+      }
+      advance();
+   }
+   return 0;
+}
+
+tuner_sim_xc5000::tuner_sim_xc5000(void)
+   : tuner_sim_regmap(2, 2, false),
+     m_fw_loaded(false),
+     m_locked(false)
+{
+}
+
+void tuner_sim_xc5000::reset(void)
+{
+   tuner_sim_regmap::reset();
+   m_fw_loaded = false;
+   m_locked = false;
+}
+
+int tuner_sim_xc5000::write(const uint8_t *buffer, size_t size)
+{
+   // Until the firmware is started every write longer than a register
+   // select is a firmware segment and leaves the registers alone.  The
+   // driver starts the firmware by writing 0 to INIT once the last segment
+   // has gone out.
+   if (!m_fw_loaded && (size > 2))
+   {
+      static const uint8_t init_cmd[] = {0x00, 0x00, 0x00, 0x00};
+      if ((size != sizeof(init_cmd)) || memcmp(buffer, init_cmd, sizeof(init_cmd)))
+      {
+         return 0;
+      }
+      m_fw_loaded = true;
+   }
+   return tuner_sim_regmap::write(buffer, size);
+}
+
+void tuner_sim_xc5000::reg_written(uint16_t reg, uint16_t value)
+{
+   // INPUT_FREQ
+   if (reg == 0x03)
+   {
+      m_locked = true;
+   }
+}
+
+uint16_t tuner_sim_xc5000::reg_read(uint16_t reg)
+{
+   switch (reg)
+   {
+      case 0x04:
+         return (m_locked ? 1 : 0);
+      case 0x07:
+         return 0x1388;
+      case 0x08:
+         return (m_fw_loaded ? 0x1388 : 0x2000);
+      case 0x09:
+         return 0;
+      default:
+         return m_regs[reg];
+   }
+}
+
+tuner_sim_s5h1411::tuner_sim_s5h1411(void)
+   : tuner_sim_regmap(1, 2, false),
+     m_locked(false)
+{
+}
+
+void tuner_sim_s5h1411::reset(void)
+{
+   tuner_sim_regmap::reset();
+   m_locked = false;
+}
+
+void tuner_sim_s5h1411::reg_written(uint16_t reg, uint16_t value)
+{
+   // Soft reset
+   if (reg == 0xF7)
+   {
+      m_locked = (value != 0);
+   }
+}
+
+uint16_t tuner_sim_s5h1411::reg_read(uint16_t reg)
+{
+   switch (reg)
+   {
+      case 0x05:
+         return 0x0066;
+      case 0xF0:
+         return (m_locked ? 0x0010 : 0);
+      case 0xF2:
+         return (m_locked ? 0x1000 : 0);
+      default:
+         return m_regs[reg];
+   }
+}
+
+tuner_sim_tda18271::tuner_sim_tda18271(void)
+   : tuner_sim_regmap(1, 1, true)
+{
+   reset();
+}
+
+void tuner_sim_tda18271::reset(void)
+{
+   tuner_sim_regmap::reset();
+   // TDA18271HDC2
+   m_regs[0x00] = 0x84;
+}
+
+uint16_t tuner_sim_tda18271::reg_read(uint16_t reg)
+{
+   // THERMO: report the low end of the selected range
+   if (reg == 0x01)
+   {
+      return (m_regs[reg] & 0x20);
+   }
+   return m_regs[reg];
+}
+
+tuner_sim_nxt2004::tuner_sim_nxt2004(void)
+   : tuner_sim_regmap(1, 1, true),
+     m_fw_bytes(0)
+{
+}
+
+void tuner_sim_nxt2004::reset(void)
+{
+   tuner_sim_regmap::reset();
+   m_fw_bytes = 0;
+}
+
+int tuner_sim_nxt2004::write(const uint8_t *buffer, size_t size)
+{
+   // Firmware download port does not auto-increment
+   if ((size > 1) && (buffer[0] == 0x2C))
+   {
+      m_pointer = 0x2C;
+      m_fw_bytes += size - 1;
+      return 0;
+   }
+   return tuner_sim_regmap::write(buffer, size);
+}
+
+uint16_t tuner_sim_nxt2004::reg_read(uint16_t reg)
+{
+   switch (reg)
+   {
+      case 0x00:
+         return 0x05;
+      case 0x21:
+         // Microcontroller command complete
+         return 0x00;
+      case 0x31:
+         // Microcontroller stopped, demodulator locked
+         return 0x30;
+      default:
+         return m_regs[reg];
+   }
+}
@@ -0,0 +1,173 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_SIM_MODELS_H__
+#define __TUNER_SIM_MODELS_H__
+
+#include <vector>
+#include "tuner_sim_device.h"
+
+/*
+ * Generic register file.  A write sets the register pointer from the first
+ * addr_bytes bytes and stores any remaining data as big-endian values of
+ * value_bytes each; a read returns values starting at the pointer.  With
+ * auto_increment the pointer advances after every value.
+ */
+class tuner_sim_regmap
+   : public tuner_sim_model
+{
+   public:
+
+      tuner_sim_regmap(size_t addr_bytes, size_t value_bytes, bool auto_increment);
+
+      virtual ~tuner_sim_regmap(void) {}
+
+      virtual int write(const uint8_t *buffer, size_t size);
+
+      virtual int read(uint8_t *buffer, size_t size);
+
+      virtual void reset(void);
+
+      uint16_t get_reg(uint16_t reg)
+      {
+         return m_regs[reg];
+      }
+
+      void set_reg(uint16_t reg, uint16_t value)
+      {
+         m_regs[reg] = value;
+      }
+
+   protected:
+
+      virtual void reg_written(uint16_t reg, uint16_t value) {}
+
+      virtual uint16_t reg_read(uint16_t reg)
+      {
+         return m_regs[reg];
+      }
+
+      void advance(void);
+
+      size_t m_addr_bytes;
+      size_t m_value_bytes;
+      bool m_auto_increment;
+      uint16_t m_pointer;
+      std::vector<uint16_t> m_regs;
+};
+
+/*
+ * XC5000: product ID reads as 0x2000 until a firmware download has been
+ * followed by a write of 0 to INIT, and the tuner reports lock once a
+ * frequency has been set.  A segment that is itself exactly that INIT
+ * write cannot be told apart from it.
+ */
+class tuner_sim_xc5000
+   : public tuner_sim_regmap
+{
+   public:
+
+      tuner_sim_xc5000(void);
+
+      virtual ~tuner_sim_xc5000(void) {}
+
+      virtual int write(const uint8_t *buffer, size_t size);
+
+      virtual void reset(void);
+
+   protected:
+
+      virtual void reg_written(uint16_t reg, uint16_t value);
+
+      virtual uint16_t reg_read(uint16_t reg);
+
+      bool m_fw_loaded;
+      bool m_locked;
+};
+
+class tuner_sim_s5h1411
+   : public tuner_sim_regmap
+{
+   public:
+
+      tuner_sim_s5h1411(void);
+
+      virtual ~tuner_sim_s5h1411(void) {}
+
+      virtual void reset(void);
+
+   protected:
+
+      virtual void reg_written(uint16_t reg, uint16_t value);
+
+      virtual uint16_t reg_read(uint16_t reg);
+
+      bool m_locked;
+};
+
+class tuner_sim_tda18271
+   : public tuner_sim_regmap
+{
+   public:
+
+      tuner_sim_tda18271(void);
+
+      virtual ~tuner_sim_tda18271(void) {}
+
+      virtual void reset(void);
+
+   protected:
+
+      virtual uint16_t reg_read(uint16_t reg);
+};
+
+class tuner_sim_nxt2004
+   : public tuner_sim_regmap
+{
+   public:
+
+      tuner_sim_nxt2004(void);
+
+      virtual ~tuner_sim_nxt2004(void) {}
+
+      virtual int write(const uint8_t *buffer, size_t size);
+
+      virtual void reset(void);
+
+      size_t firmware_bytes(void)
+      {
+         return m_fw_bytes;
+      }
+
+   protected:
+
+      virtual uint16_t reg_read(uint16_t reg);
+
+      size_t m_fw_bytes;
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*-
+ * Copyright 2015 Jason Harmening
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+#ifndef __TUNER_TRACE_H__
+#define __TUNER_TRACE_H__
+
+#include <sys/types.h>
+
+/*
+ * Transaction trace file layout, shared by tuner_record_device and
+ * tuner_replay_device.  All fields are in host byte order.
+ *
+ * The file starts with a tuner_trace_header, followed by one
+ * tuner_trace_record per operation.  Each record is followed by write_size
+ * bytes of written data, then read_size bytes of read data.  A
+ * TUNER_TRACE_SUBMIT record carries no payload of its own; it is followed by
+ * count records describing the operations in the batch.
+ *
+ * Sizes are those actually transferred.  A failed operation records no
+ * data, and a failed batch records no operations, since it is not known
+ * which of them ran.
+ */
+
+#define TUNER_TRACE_MAGIC   0x5254544CU
+#define TUNER_TRACE_VERSION 1
+
+enum tuner_trace_type
+{
+   TUNER_TRACE_WRITE = 0,
+   TUNER_TRACE_READ,
+   TUNER_TRACE_TRANSACT,
+   TUNER_TRACE_WRITE_ARRAY,
+   TUNER_TRACE_READ_ARRAY,
+   TUNER_TRACE_SUBMIT
+};
+
+typedef struct
+{
+   uint32_t magic;
+   uint32_t version;
+} tuner_trace_header;
+
+typedef struct
+{
+   uint8_t type;
+   uint8_t reserved[3];
+   int32_t error;
+   uint64_t timestamp_ns;
+   uint32_t write_size;
+   uint32_t read_size;
+   uint32_t count;
+   uint32_t reserved2;
+} tuner_trace_record;
+
+#endif
@@ -38,6 +38,10 @@
 #include "xc3028.h"
 
 #define XC3028_FW_KEY        "XC3028_FW"
+#define XC3028_FW_BUS_HZ_KEY "XC3028_FW_BUS_HZ"
+
+static tuner_config_key xc3028_fw_key(XC3028_FW_KEY);
+static tuner_config_key xc3028_fw_bus_hz_key(XC3028_FW_BUS_HZ_KEY);
 #define XC3028_MIN_FREQ      42000000
 #define XC3028_MAX_FREQ      864000000
 #define XC3028_DIVIDER       15625
@@ -81,7 +85,7 @@ xc3028::xc3028(
    {
       return;
    }
-   const char *fwfile = m_config.get_string(XC3028_FW_KEY);
+   const char *fwfile = m_config.get_string(xc3028_fw_key);
    if (fwfile == NULL)
    {
       LIBTUNERERR << "xc3028 firmware file not configured" << endl;
@@ -320,6 +324,7 @@ int xc3028::send_firmware(common_fw_header &header, const char *fwtypename, uint
       return EINVAL;
    }
    char *buf = reinterpret_cast<char*>(m_firmware->buffer()) + offset;
+   tuner_device::bus_speed speed(m_device, m_config.get_number<uint32_t>(xc3028_fw_bus_hz_key, 0));
    uint32_t i = 0;
    while (!error && (i < (size - 1)))
    {
@@ -358,14 +363,19 @@ int xc3028::send_firmware(common_fw_header &header, const char *fwtypename, uint
             }
             else
             {
-               uint8_t chunk[64];
-               chunk[0] = buf[i++];
+               // Legacy bridges take 64-byte writes, including the register byte
+               size_t max_transfer = m_device.max_transfer_size();
+               max_transfer = ((max_transfer > 1) ? (max_transfer - 1) : 63);
+               struct iovec iov[2];
+               iov[0].iov_base = &buf[i++];
+               iov[0].iov_len = 1;
                uint16_t remaining = chunksize - 1;
                while (!error && remaining)
                {
-                  uint16_t transfer = ((remaining > (sizeof(chunk) - 1)) ? (sizeof(chunk) - 1) : remaining);
-                  memcpy(&chunk[1], &buf[i], transfer);
-                  error = m_device.write(chunk, transfer + 1);
+                  uint16_t transfer = ((remaining > max_transfer) ? (uint16_t)max_transfer : remaining);
+                  iov[1].iov_base = &buf[i];
+                  iov[1].iov_len = transfer;
+                  error = m_device.write(iov, 2);
                   remaining -= transfer;
                   i += transfer;
                }
@@ -420,6 +430,7 @@ int xc3028::set_channel(const dvb_channel &channel, dvb_interface &interface)
       default:
          return EINVAL;
    }
+   tuner_device::bus_lock lock(m_device);
    int error = load_base_fw(base_flags);
    error = (error ? error : load_dvb_fw(dvb_flags, channel.modulation));
    load_scode_fw(0, 0);
@@ -461,6 +472,7 @@ int xc3028::set_channel(const avb_channel &channel)
       default:
          break;
    }
+   tuner_device::bus_lock lock(m_device);
    int error = load_base_fw(base_flags);
    error = (error ? error : load_avb_fw(0, channel.video_format, channel.audio_format));
    load_scode_fw(0, 0);
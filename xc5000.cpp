@@ -49,6 +49,11 @@ using namespace std;
 
 #define XC5000_FW_KEY "XC5000_FW"
 #define XC5000_SOURCE_KEY "XC5000_SOURCE"
+#define XC5000_FW_BUS_HZ_KEY "XC5000_FW_BUS_HZ"
+
+static tuner_config_key xc5000_fw_key(XC5000_FW_KEY);
+static tuner_config_key xc5000_source_key(XC5000_SOURCE_KEY);
+static tuner_config_key xc5000_fw_bus_hz_key(XC5000_FW_BUS_HZ_KEY);
 
 xc5000::xc5000(
    tuner_config &config, 
@@ -62,6 +67,7 @@ xc5000::xc5000(
      avb_driver(config, device),
      m_ifreq_hz(ifreq_hz),
      m_fw_loaded(false),
+     m_fw_changed(false),
      m_reset_cb(reset_cb),
      m_reset_arg(reset_arg)
 {
@@ -72,6 +78,11 @@ xc5000::xc5000(
       
       return;
    }
+   error = m_config.add_listener(*this);
+   if (error)
+   {
+      return;
+   }
    uint16_t id = 0;
    error = read_reg(XC5000_REG_PRODUCT_ID, id);
    if (error)
@@ -88,11 +99,30 @@ xc5000::xc5000(
    }
 }
 
+xc5000::~xc5000(void)
+{
+   m_config.remove_listener(*this);
+}
+
+void xc5000::config_changed(tuner_config &config, const list<string> &keys)
+{
+   // XC5000_SOURCE is re-read on every tune; a new firmware file must be
+   // uploaded on the next one even if the chip reports firmware loaded.
+   for (list<string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+   {
+      if (strcasecmp(it->c_str(), XC5000_FW_KEY) == 0)
+      {
+         __atomic_store_n(&m_fw_changed, true, __ATOMIC_RELEASE);
+      }
+   }
+}
+
 int xc5000::read_reg(xc5000_read_reg_t reg, uint16_t &data)
 {
    uint8_t buf[2];
    buf[0] = (reg >> 8) & 0xFF;
    buf[1] = reg & 0xFF;
+   tuner_device::bus_lock lock(m_device);
    int error = m_device.write(buf, sizeof(buf));
    if (!error)
    {
@@ -112,6 +142,7 @@ int xc5000::write_reg(xc5000_write_reg_t reg, uint16_t data)
    buf[1] = reg & 0xFF;
    buf[2] = (data >> 8) & 0xFF;
    buf[3] = data & 0xFF;
+   tuner_device::bus_lock lock(m_device);
    int error = m_device.write(buf, sizeof(buf));
    uint16_t busy = 0, elapsed = 0;
    while (!error && (elapsed < 1000))
@@ -129,7 +160,11 @@ int xc5000::write_reg(xc5000_write_reg_t reg, uint16_t data)
 
 int xc5000::load_firmware(void)
 {
-   const char *fwfile = m_config.get_string(XC5000_FW_KEY);
+   if (__atomic_exchange_n(&m_fw_changed, false, __ATOMIC_ACQ_REL))
+   {
+      m_fw_loaded = false;
+   }
+   const char *fwfile = m_config.get_string(xc5000_fw_key);
    if (fwfile == NULL)
    {
       LIBTUNERERR << "xc5000: Firmware file not configured" << endl;
@@ -142,12 +177,25 @@ int xc5000::load_firmware(void)
       LIBTUNERERR << "xc5000: Unable to create firmware image" << endl;
       return error;
    }
+   error = load_firmware(fw);
+   if (!error)
+   {
+      fw.update();
+   }
+   return error;
+}
+
+int xc5000::load_firmware(tuner_firmware &fw)
+{
    if (m_fw_loaded && fw.up_to_date())
    {
       DIAGNOSTIC(LIBTUNERLOG << "xc5000: NOT updating firmware" << endl)
       return 0;
    }
    LIBTUNERLOG << "xc5000: Loading firmware..." << endl;
+   tuner_device::bus_lock lock(m_device);
+   tuner_device::bus_speed speed(m_device, m_config.get_number<uint32_t>(xc5000_fw_bus_hz_key, 0));
+   int error = 0;
    uint8_t *fwdata = reinterpret_cast<uint8_t*>(fw.buffer());
    size_t offset = 0;
    while (!error && (offset < (fw.length() - 1)))
@@ -177,19 +225,51 @@ int xc5000::load_firmware(void)
                << " extends beyond end of file" << endl;
             error = EINVAL;
          }
-         error = m_device.write(fwdata + offset, header);
+         error = (error ? error : write_segment(fwdata + offset, header));
          offset += header;
       }
    }
    if (!error)
    {
       m_fw_loaded = true;
-      fw.update();
    }
    LIBTUNERLOG << "xc5000: Finished" << endl;
    return error;
 }
 
+/*
+ * Each segment starts with the 2-byte register address it is written to.
+ * Segments larger than the transport allows are split, repeating the
+ * address in front of every piece.
+ */
+int xc5000::write_segment(const uint8_t *segment, size_t size)
+{
+   size_t max_transfer = m_device.max_transfer_size();
+   if ((max_transfer == 0) || (size <= max_transfer) || (size <= 2))
+   {
+      return m_device.write(segment, size);
+   }
+   if (max_transfer <= 2)
+   {
+      return EINVAL;
+   }
+   struct iovec iov[2];
+   iov[0].iov_base = const_cast<uint8_t*>(segment);
+   iov[0].iov_len = 2;
+   int error = 0;
+   for (size_t offset = 2; !error && (offset < size); offset += iov[1].iov_len)
+   {
+      iov[1].iov_base = const_cast<uint8_t*>(segment) + offset;
+      iov[1].iov_len = size - offset;
+      if (iov[1].iov_len > (max_transfer - 2))
+      {
+         iov[1].iov_len = max_transfer - 2;
+      }
+      error = m_device.write(iov, 2);
+   }
+   return error;
+}
+
 int xc5000::init(void)
 {
    int error = load_firmware();
@@ -203,6 +283,7 @@ int xc5000::init(void)
 
 int xc5000::set_channel(const dvb_channel &channel, dvb_interface &interface)
 {
+   tuner_device::bus_lock lock(m_device);
    int error = init();
    if (error)
    {
@@ -280,6 +361,7 @@ int xc5000::set_frequency(uint32_t frequency_hz)
 
 int xc5000::set_channel(const avb_channel &channel)
 {
+   tuner_device::bus_lock lock(m_device);
    int error = init();
    if (error)
    {
@@ -431,7 +513,7 @@ int xc5000::set_channel(const avb_channel &channel)
 
 int xc5000::set_source(xc5000_source_t &source)
 {
-   const char *src = m_config.get_string(XC5000_SOURCE_KEY);
+   const char *src = m_config.get_string(xc5000_source_key);
    if (src != NULL)
    {
       if (strcasecmp(src, "air") == 0)
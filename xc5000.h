@@ -45,10 +45,13 @@
 
 #include "dvb_driver.h"
 #include "avb_driver.h"
+#include "tuner_firmware_broadcast.h"
 
 class xc5000
    : public dvb_driver,
-     public avb_driver
+     public avb_driver,
+     public tuner_firmware_target,
+     public tuner_config_listener
 {
    public:
    
@@ -62,7 +65,7 @@ class xc5000
          void *reset_arg,
          int &error);
    
-      virtual ~xc5000(void) {}
+      virtual ~xc5000(void);
       
       virtual int set_channel(const dvb_channel &channel, dvb_interface &interface);
 
@@ -78,6 +81,10 @@ class xc5000
       virtual void stop(void) {}
 
       virtual void reset(void) {}
+
+      virtual int load_firmware(tuner_firmware &fw);
+
+      virtual void config_changed(tuner_config &config, const std::list<std::string> &keys);
    
    private:
    
@@ -122,6 +129,8 @@ class xc5000
       int read_reg(xc5000_read_reg_t reg, uint16_t &data);
       
       int write_reg(xc5000_write_reg_t reg, uint16_t data);
+
+      int write_segment(const uint8_t *segment, size_t size);
    
       int load_firmware(void);
       
@@ -133,6 +142,7 @@ class xc5000
 
       uint32_t m_ifreq_hz;
       bool m_fw_loaded;
+      bool m_fw_changed;
       xc5000_reset_callback m_reset_cb;
       void *m_reset_arg;
 };